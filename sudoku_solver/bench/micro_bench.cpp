@@ -0,0 +1,281 @@
+/*
+ * File:   micro_bench.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Microbenchmarks of the solver hot paths. Each benchmark runs a fixed batch of operations a few
+ * times to warm up, then times the batch over several repetitions and reports the mean time per
+ * operation, its relative standard deviation and the fastest repetition.
+ *
+ * Usage: SudokuBench [repetitions]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+#include <chrono>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include "src/sudoku_solver.hpp"
+#include "src/constraint_propagation.hpp"
+#include "src/exact_cover.hpp"
+
+/// Repetitions run before timing starts
+static const int WARMUP_REPS = 3;
+/// Keeps the compiler from dropping the results of the benchmarked calls
+static volatile long sink = 0;
+
+/// A hard 9x9 puzzle, one row per string
+static const char* HARD_ROWS[9] = {
+  "4,0,0,0,0,0,8,0,5", "0,3,0,0,0,0,0,0,0", "0,0,0,7,0,0,0,0,0",
+  "0,2,0,0,0,0,0,6,0", "0,0,0,0,8,0,4,0,0", "0,0,0,0,1,0,0,0,0",
+  "0,0,0,6,0,3,0,7,0", "5,0,0,2,0,0,0,0,0", "1,0,4,0,0,0,0,0,0"};
+
+/*! \brief Times a batch of operations and prints its statistics.
+ *
+ * \param name Benchmark name.
+ * \param ops Number of operations in a batch.
+ * \param reps Number of timed repetitions.
+ * \param batch Runs one batch.
+ */
+template <typename Batch>
+static void run (const char* name, const long ops, const int reps, Batch batch)
+{
+  std::vector <double> ns (reps);
+  double mean = 0.0;
+  double var = 0.0;
+  double best = 0.0;
+
+  for (int r = 0; r < WARMUP_REPS; ++r)
+  {
+    batch ();
+  }
+  for (int r = 0; r < reps; ++r)
+  {
+    const std::chrono::steady_clock::time_point then = std::chrono::steady_clock::now ();
+
+    batch ();
+    ns[r] = std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - then)
+      .count () / ops;
+    mean += ns[r];
+    best = (r == 0 || ns[r] < best ? ns[r] : best);
+  }
+  mean /= reps;
+  for (int r = 0; r < reps; ++r)
+  {
+    var += (ns[r] - mean) * (ns[r] - mean);
+  }
+  var /= (reps > 1 ? reps - 1 : 1);
+  printf ("%-32s %12.1f ns/op  +-%5.1f%%  min %12.1f\n", name, mean,
+    (mean > 0.0 ? 100.0 * sqrt (var) / mean : 0.0), best);
+}
+
+/// Reaches the private hot paths of the solvers
+struct MicroBench
+{
+  static std::vector <std::vector <int> > hard_grid ()
+  {
+    std::vector <std::vector <int> > grid (9, std::vector <int> (9, 0));
+
+    for (int i = 0; i < 9; ++i)
+    {
+      for (int j = 0; j < 9; ++j)
+      {
+        grid[i][j] = HARD_ROWS[i][2 * j] - '0';
+      }
+    }
+
+    return grid;
+  }
+
+  static void cell (const int reps)
+  {
+    run ("Cell<9> eliminate/count", 9 * 1000, reps, [] ()
+    {
+      for (int i = 0; i < 1000; ++i)
+      {
+        Cell <9> cell;
+
+        for (int v = 1; v <= 9; ++v)
+        {
+          cell.eliminate (v);
+          sink += cell.count ();
+        }
+      }
+    });
+    run ("Cell<9> is_on/get_value", 10 * 1000, reps, [] ()
+    {
+      Cell <9> cell;
+
+      for (int v = 1; v < 9; ++v)
+      {
+        cell.eliminate (v);
+      }
+      for (int i = 0; i < 1000; ++i)
+      {
+        for (int v = 1; v <= 9; ++v)
+        {
+          sink += cell.is_on (v);
+        }
+        sink += cell.get_value ();
+      }
+    });
+  }
+
+  static void csp (const int reps)
+  {
+    typedef CSPSolver<3, 3> Solver;
+    const Solver root (hard_grid ());
+    std::vector <std::pair <int, int> > moves;
+
+    /// Take away one candidate of every open cell, none of them empties a cell or a unit
+    for (int k = 0; k < Solver::CELLS; ++k)
+    {
+      if (root.possible (k).count () > 2)
+      {
+        for (int v = 1; v <= 9; ++v)
+        {
+          if (root.possible (k).is_on (v))
+          {
+            moves.push_back (std::make_pair (k, v));
+            break;
+          }
+        }
+      }
+    }
+    run ("CSPSolver<3,3> copy", 1000, reps, [&root] ()
+    {
+      for (int i = 0; i < 1000; ++i)
+      {
+        Solver solver (root);
+
+        sink += solver.is_valid ();
+      }
+    });
+    run ("CSPSolver<3,3>::eliminate", 100 * moves.size (), reps, [&root, &moves] ()
+    {
+      for (int i = 0; i < 100; ++i)
+      {
+        Solver solver (root);
+
+        for (unsigned int m = 0; m < moves.size (); ++m)
+        {
+          sink += solver.eliminate (moves[m].first, moves[m].second,
+            solver.because (Solver::Reason::DECISION));
+        }
+      }
+    });
+    run ("CSPSolver<3,3>::least_count", 10000, reps, [&root] ()
+    {
+      for (int i = 0; i < 10000; ++i)
+      {
+        sink += root.least_count ();
+      }
+    });
+  }
+
+  static void dlx (const int reps)
+  {
+    ExactCoverSolver solver;
+
+    solver.init (3, 3);
+    run ("ExactCoverSolver::cover/uncover", solver.MAX_COLS_, reps, [&solver] ()
+    {
+      for (int col = 1; col <= solver.MAX_COLS_; ++col)
+      {
+        solver.cover (col);
+        solver.uncover (col);
+      }
+    });
+    run ("ExactCoverSolver::pick_next_col", 10000, reps, [&solver] ()
+    {
+      int count = 0;
+
+      for (int i = 0; i < 10000; ++i)
+      {
+        sink += solver.pick_next_col (count);
+      }
+    });
+    run ("ExactCoverSolver::init 9x9", 100, reps, [] ()
+    {
+      for (int i = 0; i < 100; ++i)
+      {
+        ExactCoverSolver fresh;
+
+        sink += fresh.init (3, 3);
+      }
+    });
+    run ("ExactCoverSolver::init 16x16", 10, reps, [] ()
+    {
+      for (int i = 0; i < 10; ++i)
+      {
+        ExactCoverSolver fresh;
+
+        sink += fresh.init (4, 4);
+      }
+    });
+  }
+
+  static void io (const int reps)
+  {
+    const int PUZZLES = 1000;
+    char path[] = "/tmp/sudoku_bench_XXXXXX";
+    const int fd = mkstemp (path);
+    SudokuSolver sudoku;
+    std::vector <Puzzle> puzzles;
+    std::ofstream file;
+
+    if (fd == -1)
+    {
+      printf ("WARNING! Could not create a temporary input file. Skipping I/O benchmarks.\n");
+      return;
+    }
+    close (fd);
+    file.open (path);
+    for (int p = 0; p < PUZZLES; ++p)
+    {
+      for (int i = 0; i < 9; ++i)
+      {
+        file << HARD_ROWS[i] << "\n";
+      }
+      file << "\n";
+    }
+    file.close ();
+    run ("SudokuSolver input parsing", PUZZLES, reps, [&sudoku, &path] ()
+    {
+      std::vector <Puzzle> parsed;
+
+      sink += sudoku.validate_input (path, parsed);
+    });
+    sudoku.validate_input (path, puzzles);
+    unlink (path);
+    run ("SudokuSolver output formatting", PUZZLES, reps, [&sudoku, &puzzles] ()
+    {
+      std::ofstream out ("/dev/null");
+
+      for (unsigned int p = 0; p < puzzles.size (); ++p)
+      {
+        sudoku.output_puzzle (puzzles[p], out);
+      }
+    });
+  }
+};
+
+int main (int argc, char** argv)
+{
+  const int reps = (argc > 1 && atoi (argv[1]) > 1 ? atoi (argv[1]) : 15);
+
+  CSPSolver<3, 3>::init ();
+  printf ("%-32s %12s %15s %18s\n", "Benchmark", "mean", "rsd", "fastest");
+  MicroBench::cell (reps);
+  MicroBench::csp (reps);
+  MicroBench::dlx (reps);
+  MicroBench::io (reps);
+
+  return 0;
+}
@@ -0,0 +1,345 @@
+/*
+ * File:   throughput_bench.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * End-to-end throughput benchmark. Tiered corpora are generated from a seed, so that every run
+ * measures the same puzzles without any input file, and every technique solves every corpus. Each
+ * run reports the throughput, the median, 90th, 99th percentile and worst latency of a puzzle and
+ * the number of search nodes visited, on the terminal and optionally as CSV or JSON.
+ *
+ * Usage: SudokuThroughput [-n <count>] [-s <seed>] [-N <nodes>] [--csv <file>] [--json <file>]
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "src/sudoku_solver.hpp"
+#include "src/puzzle_generator.hpp"
+
+/// Well known hard 9x9 puzzles, the pathological corpus is made of random transformations of them
+static const char* CLASSICS[] = {
+  "4.....8.5.3..........7......2.....6.....8.4......1.......6.3.7.5..2.....1.4......",
+  "8..........36......7..9.2...5...7.......457.....1...3...1....68..85...1..9....4..",
+  "1....7.9..3..2...8..96..5....53..9...1..8...26....4...3......1..4......7..7...3..",
+  "1.......2.9.4...5...6...7...5.9.3.......7.......85..4.7.....6...3...9.8...2.....1",
+  ".......39.....1..5..3.5.8....8.9...6.7...2...1..4.......9.8..5..2....6..4..7....."};
+static const int CLASSIC_COUNT = sizeof (CLASSICS) / sizeof (CLASSICS[0]);
+
+/// Techniques by code, the bitboard ones only run on 9x9 corpora
+static const char* TECHNIQUES[] = {"", "csp", "dlx", "bitboard", "simd"};
+
+struct Tier
+{
+  const char* name;
+  int box_rows;
+  int box_cols;
+  /// Target number of clues, zero for minimal puzzles and -1 for the classics
+  int clues;
+  /// Share of the corpus size given on the command line, in percent
+  int share;
+};
+
+static const Tier TIERS[] = {
+  {"easy", 3, 3, 36, 100},
+  {"medium", 3, 3, 30, 100},
+  {"hard", 3, 3, 0, 100},
+  {"pathological", 3, 3, -1, 10},
+  {"16x16", 4, 4, 120, 10}};
+static const int TIER_COUNT = sizeof (TIERS) / sizeof (TIERS[0]);
+
+struct Result
+{
+  std::string tier;
+  int grid_size;
+  std::string technique;
+  int puzzles;
+  int solved;
+  int timed_out;
+  double mean_clues;
+  double seconds;
+  double median_us;
+  double p90_us;
+  double p99_us;
+  double max_us;
+  long nodes;
+};
+
+/*! \brief Builds the corpus of a tier.
+ *
+ * \param tier Tier of the corpus.
+ * \param count Number of puzzles.
+ * \param seed Seed of the generator.
+ * \param corpus Receives the puzzles.
+ *
+ * \return false if a puzzle could not be generated, true otherwise.
+ */
+static bool build_corpus (const Tier& tier, const int count, const unsigned int seed,
+  std::vector <std::vector <std::vector <int> > >& corpus)
+{
+  PuzzleGenerator generator;
+
+  if (!generator.init (tier.box_rows, tier.box_cols))
+  {
+    return false;
+  }
+  generator.seed (seed);
+  corpus.resize (count);
+  for (int p = 0; p < count; ++p)
+  {
+    if (tier.clues >= 0)
+    {
+      if (generator.generate (tier.clues, corpus[p]) == 0)
+      {
+        return false;
+      }
+      continue;
+    }
+    corpus[p].assign (9, std::vector <int> (9, 0));
+    for (int k = 0; k < 81; ++k)
+    {
+      const char c = CLASSICS[p % CLASSIC_COUNT][k];
+
+      corpus[p][k / 9][k % 9] = (c >= '1' && c <= '9' ? c - '0' : 0);
+    }
+    generator.shuffle (corpus[p]);
+  }
+
+  return true;
+}
+
+/*! \brief Returns a percentile of sorted samples, by nearest rank.
+ *
+ * \param sorted Samples in ascending order.
+ * \param fraction Percentile between 0 and 1.
+ *
+ * \return Value of the percentile.
+ */
+static double percentile (const std::vector <double>& sorted, const double fraction)
+{
+  size_t rank = (size_t) (fraction * sorted.size () + 0.999999);
+
+  rank = std::max ((size_t) 1, std::min (rank, sorted.size ()));
+
+  return sorted[rank - 1];
+}
+
+/*! \brief Solves a corpus with a technique and measures it.
+ *
+ * \param tier Tier of the corpus.
+ * \param corpus Puzzles of the corpus.
+ * \param technique Technique code.
+ * \param node_limit Search node limit per puzzle, zero for none.
+ *
+ * \return Measurements of the run.
+ */
+static Result run (const Tier& tier, const std::vector <std::vector <std::vector <int> > >& corpus,
+  const int technique, const long node_limit)
+{
+  SudokuSolver solver;
+  std::vector <double> latencies (corpus.size ());
+  Puzzle puzzle;
+  Result result;
+  long clues = 0;
+
+  solver.init ();
+  solver.set_technique (technique);
+  solver.set_node_limit (node_limit);
+  result.tier = tier.name;
+  result.grid_size = tier.box_rows * tier.box_cols;
+  result.technique = TECHNIQUES[technique];
+  result.puzzles = corpus.size ();
+  result.solved = 0;
+  result.timed_out = 0;
+  result.nodes = 0;
+
+  const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now ();
+
+  for (unsigned int p = 0; p < corpus.size (); ++p)
+  {
+    puzzle.clear ();
+    puzzle.input_grid = corpus[p];
+    puzzle.output_grid = corpus[p];
+    puzzle.box_rows = tier.box_rows;
+    puzzle.box_cols = tier.box_cols;
+
+    const std::chrono::steady_clock::time_point then = std::chrono::steady_clock::now ();
+
+    solver.solve_puzzle (puzzle);
+    latencies[p] = std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now () -
+      then).count ();
+    result.solved += puzzle.solved;
+    result.timed_out += puzzle.timed_out;
+    result.nodes += puzzle.nodes;
+    for (unsigned int i = 0; i < corpus[p].size (); ++i)
+    {
+      clues += corpus[p][i].size () - std::count (corpus[p][i].begin (), corpus[p][i].end (), 0);
+    }
+  }
+  result.seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - begin)
+    .count ();
+  std::sort (latencies.begin (), latencies.end ());
+  result.mean_clues = (double) clues / std::max (1, result.puzzles);
+  result.median_us = percentile (latencies, 0.5);
+  result.p90_us = percentile (latencies, 0.9);
+  result.p99_us = percentile (latencies, 0.99);
+  result.max_us = latencies.back ();
+
+  return result;
+}
+
+/*! \brief Writes the results as CSV, one line per run.
+ *
+ * \param path Output file.
+ * \param seed Seed of the corpora.
+ * \param results Measurements.
+ *
+ * \return false if the file could not be written, true otherwise.
+ */
+static bool write_csv (const char* path, const unsigned int seed,
+  const std::vector <Result>& results)
+{
+  FILE* out = fopen (path, "w");
+
+  if (out == NULL)
+  {
+    return false;
+  }
+  fprintf (out, "seed,tier,grid_size,technique,puzzles,solved,timed_out,mean_clues,seconds,"
+    "puzzles_per_sec,median_us,p90_us,p99_us,max_us,nodes\n");
+  for (unsigned int i = 0; i < results.size (); ++i)
+  {
+    const Result& r = results[i];
+
+    fprintf (out, "%u,%s,%d,%s,%d,%d,%d,%.2f,%.6f,%.1f,%.2f,%.2f,%.2f,%.2f,%ld\n", seed,
+      r.tier.c_str (), r.grid_size, r.technique.c_str (), r.puzzles, r.solved, r.timed_out,
+      r.mean_clues, r.seconds, r.puzzles / r.seconds, r.median_us, r.p90_us, r.p99_us, r.max_us,
+      r.nodes);
+  }
+
+  return fclose (out) == 0;
+}
+
+/*! \brief Writes the results as a JSON document.
+ *
+ * \param path Output file.
+ * \param seed Seed of the corpora.
+ * \param results Measurements.
+ *
+ * \return false if the file could not be written, true otherwise.
+ */
+static bool write_json (const char* path, const unsigned int seed,
+  const std::vector <Result>& results)
+{
+  FILE* out = fopen (path, "w");
+
+  if (out == NULL)
+  {
+    return false;
+  }
+  fprintf (out, "{\n  \"seed\": %u,\n  \"results\": [\n", seed);
+  for (unsigned int i = 0; i < results.size (); ++i)
+  {
+    const Result& r = results[i];
+
+    fprintf (out, "    {\"tier\": \"%s\", \"grid_size\": %d, \"technique\": \"%s\", "
+      "\"puzzles\": %d, \"solved\": %d, \"timed_out\": %d, \"mean_clues\": %.2f, "
+      "\"seconds\": %.6f, \"puzzles_per_sec\": %.1f, \"median_us\": %.2f, \"p90_us\": %.2f, "
+      "\"p99_us\": %.2f, \"max_us\": %.2f, \"nodes\": %ld}%s\n", r.tier.c_str (), r.grid_size,
+      r.technique.c_str (), r.puzzles, r.solved, r.timed_out, r.mean_clues, r.seconds,
+      r.puzzles / r.seconds, r.median_us, r.p90_us, r.p99_us, r.max_us, r.nodes,
+      (i + 1 < results.size () ? "," : ""));
+  }
+  fprintf (out, "  ]\n}\n");
+
+  return fclose (out) == 0;
+}
+
+int main (int argc, char** argv)
+{
+  int count = 200;
+  unsigned int seed = 1;
+  long node_limit = 0;
+  const char* csv = NULL;
+  const char* json = NULL;
+  std::vector <Result> results;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 < argc && (strcmp (argv[i], "-n") == 0 || strcmp (argv[i], "--count") == 0))
+    {
+      count = std::max (1, atoi (argv[++i]));
+    }
+    else if (i + 1 < argc && (strcmp (argv[i], "-s") == 0 || strcmp (argv[i], "--seed") == 0))
+    {
+      seed = atol (argv[++i]);
+    }
+    else if (i + 1 < argc && (strcmp (argv[i], "-N") == 0 ||
+      strcmp (argv[i], "--node-limit") == 0))
+    {
+      node_limit = atol (argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp (argv[i], "--csv") == 0)
+    {
+      csv = argv[++i];
+    }
+    else if (i + 1 < argc && strcmp (argv[i], "--json") == 0)
+    {
+      json = argv[++i];
+    }
+    else
+    {
+      printf ("Usage: SudokuThroughput [-n <count>] [-s <seed>] [-N <nodes>] [--csv <file>] "
+        "[--json <file>]\n");
+      return 0;
+    }
+  }
+  printf ("%-13s %-9s %7s %7s %12s %11s %11s %11s %11s %12s\n", "Tier", "Technique", "Puzzles",
+    "Solved", "Puzzles/s", "Median us", "P90 us", "P99 us", "Max us", "Nodes");
+  for (int t = 0; t < TIER_COUNT; ++t)
+  {
+    const Tier& tier = TIERS[t];
+    std::vector <std::vector <std::vector <int> > > corpus;
+
+    /// Each tier has its own seed, so that resizing one corpus leaves the others alone
+    if (!build_corpus (tier, std::max (1, count * tier.share / 100), seed + t, corpus))
+    {
+      printf ("ERROR! Could not generate the %s corpus.\n", tier.name);
+      return 1;
+    }
+    for (int technique = 1; technique <= 4; ++technique)
+    {
+      if (technique > 2 && tier.box_rows * tier.box_cols != 9)
+      {
+        continue;
+      }
+      results.push_back (run (tier, corpus, technique, node_limit));
+
+      const Result& r = results.back ();
+
+      printf ("%-13s %-9s %7d %7d %12.1f %11.1f %11.1f %11.1f %11.1f %12ld\n", r.tier.c_str (),
+        r.technique.c_str (), r.puzzles, r.solved, r.puzzles / r.seconds, r.median_us, r.p90_us,
+        r.p99_us, r.max_us, r.nodes);
+      fflush (stdout);
+    }
+  }
+  if (csv != NULL && !write_csv (csv, seed, results))
+  {
+    printf ("ERROR! Could not write %s.\n", csv);
+    return 1;
+  }
+  if (json != NULL && !write_json (json, seed, results))
+  {
+    printf ("ERROR! Could not write %s.\n", json);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * File:   alloc_counter.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ */
+
+#include <sys/resource.h>
+
+#include "alloc_counter.hpp"
+
+bool AllocCounter::enabled_ = false;
+bool AllocCounter::hooked_ = false;
+thread_local AllocCounts AllocCounter::counts_;
+
+void AllocCounter::enable ()
+{
+  enabled_ = true;
+}
+
+bool AllocCounter::hooked ()
+{
+  return hooked_;
+}
+
+void AllocCounter::set_hooked ()
+{
+  hooked_ = true;
+}
+
+AllocCounts AllocCounter::current ()
+{
+  return counts_;
+}
+
+AllocCounts AllocCounter::since (const AllocCounts& before)
+{
+  AllocCounts counts = counts_;
+
+  counts.allocations -= before.allocations;
+  counts.bytes -= before.bytes;
+
+  return counts;
+}
+
+long AllocCounter::peak_rss ()
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+  {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  /// Linux and the BSDs give it in kilobytes
+  return usage.ru_maxrss * 1024L;
+#endif
+}
@@ -0,0 +1,110 @@
+/*
+ * File:   alloc_counter.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Accounting of the memory allocated through operator new, per thread. The counts are fed by the
+ * replacements of the global operator new in alloc_hooks.cpp, which only the command-line tool links
+ * in, so that embedding the solver never replaces the allocator of the host program. Without the
+ * hooks the counts stay at zero.
+ *
+ * Counting is off by default. Every allocation then costs a single test of a flag that never
+ * changes during the run.
+ */
+
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include <stddef.h>
+
+/// Allocations made over some span of time. Plain data, so that the thread-local counts need no
+/// construction inside operator new.
+struct AllocCounts
+{
+  long allocations;
+  long bytes;
+
+  void clear ()
+  {
+    allocations = 0;
+    bytes = 0;
+  }
+
+  void add (const AllocCounts& other)
+  {
+    allocations += other.allocations;
+    bytes += other.bytes;
+  }
+};
+
+//==================================================================================================
+//==================================================================================================
+
+class AllocCounter
+{
+public:
+  /*! \brief Enables counting. Must be called before any other thread is started.
+   */
+  static void enable ();
+
+  /*! \brief Returns whether counting is enabled.
+   *
+   * \return Status of type bool.
+   */
+  static inline bool enabled ()
+  {
+    return enabled_;
+  }
+
+  /*! \brief Returns whether the allocation hooks are linked in, i.e. whether anything is counted.
+   *
+   * \return Status of type bool.
+   */
+  static bool hooked ();
+
+  /*! \brief Marks the allocation hooks as linked in. Only called by the hooks.
+   */
+  static void set_hooked ();
+
+  /*! \brief Accounts for an allocation of the calling thread. Only called by the hooks.
+   *
+   * \param bytes Size of the allocation.
+   */
+  static inline void allocated (const size_t bytes)
+  {
+    if (enabled_)
+    {
+      ++counts_.allocations;
+      counts_.bytes += bytes;
+    }
+  }
+
+  /*! \brief Returns the allocations of the calling thread since counting was enabled.
+   *
+   * \return Counts of type AllocCounts.
+   */
+  static AllocCounts current ();
+
+  /*! \brief Returns the allocations of the calling thread since an earlier call to current ().
+   *
+   * \param before Counts returned by current ().
+   *
+   * \return Counts of type AllocCounts.
+   */
+  static AllocCounts since (const AllocCounts& before);
+
+  /*! \brief Returns the largest resident set size of the process so far.
+   *
+   * \return Size in bytes of type long, zero if it is not known.
+   */
+  static long peak_rss ();
+
+private:
+  static bool enabled_;
+  static bool hooked_;
+  static thread_local AllocCounts counts_;
+};
+
+#endif /// ALLOC_COUNTER_HPP
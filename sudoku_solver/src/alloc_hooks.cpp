@@ -0,0 +1,75 @@
+/*
+ * File:   alloc_hooks.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Replacements of the global operator new and delete that feed AllocCounter. Only linked into the
+ * command-line tool, never into code that embeds the solver.
+ */
+
+#include <stdlib.h>
+#include <new>
+
+#include "alloc_counter.hpp"
+
+/// Tells AllocCounter that the hooks are in place, before main () runs
+static struct AllocHooks
+{
+  AllocHooks ()
+  {
+    AllocCounter::set_hooked ();
+  }
+} hooks_;
+
+void* operator new (size_t size)
+{
+  void* ptr = NULL;
+
+  AllocCounter::allocated (size);
+  ptr = malloc (size > 0 ? size : 1);
+  if (ptr == NULL)
+  {
+    throw std::bad_alloc ();
+  }
+
+  return ptr;
+}
+
+void* operator new[] (size_t size)
+{
+  return operator new (size);
+}
+
+void* operator new (size_t size, const std::nothrow_t&) noexcept
+{
+  AllocCounter::allocated (size);
+
+  return malloc (size > 0 ? size : 1);
+}
+
+void* operator new[] (size_t size, const std::nothrow_t& tag) noexcept
+{
+  return operator new (size, tag);
+}
+
+void operator delete (void* ptr) noexcept
+{
+  free (ptr);
+}
+
+void operator delete[] (void* ptr) noexcept
+{
+  free (ptr);
+}
+
+void operator delete (void* ptr, const std::nothrow_t&) noexcept
+{
+  free (ptr);
+}
+
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept
+{
+  free (ptr);
+}
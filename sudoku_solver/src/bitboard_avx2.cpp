@@ -0,0 +1,150 @@
+/*
+ * File:   bitboard_avx2.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * AVX2 instantiations of the vectorized bitboard kernels. This file alone is compiled with -mavx2, so
+ * the kernel is only ever called after select_kernel () has checked the host CPU. Everything defined
+ * here has internal linkage, so no AVX2 code can leak into the rest of the program.
+ */
+
+#include "bitboard_batch.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace
+{
+
+/*! \brief AVX2 vector of two digit boards side by side, one band per 32-bit lane.
+ */
+struct Avx2Vec
+{
+  static const int DIGITS = 2;
+  static const int LANES = 8;
+  __m256i v;
+
+  static Avx2Vec make (const __m256i x)
+  {
+    Avx2Vec y;
+    y.v = x;
+    return y;
+  }
+
+  static Avx2Vec load (const Bitboard* p)
+  {
+    return make (_mm256_loadu_si256 ((const __m256i*) p));
+  }
+
+  static void store (Bitboard* p, const Avx2Vec& x, const int n)
+  {
+    if (n == DIGITS)
+    {
+      _mm256_storeu_si256 ((__m256i*) p, x.v);
+    }
+    else
+    {
+      _mm_storeu_si128 ((__m128i*) p, _mm256_castsi256_si128 (x.v));
+    }
+  }
+
+  static Avx2Vec band (const uint32_t c)
+  {
+    return make (_mm256_set_epi32 (0, c, c, c, 0, c, c, c));
+  }
+
+  static Avx2Vec broadcast (const Bitboard& b)
+  {
+    return make (_mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i*) &b)));
+  }
+
+  static Avx2Vec splat (const uint32_t c)
+  {
+    return make (_mm256_set1_epi32 (c));
+  }
+
+  static Avx2Vec load_lanes (const uint32_t* p)
+  {
+    return make (_mm256_loadu_si256 ((const __m256i*) p));
+  }
+
+  static void store_lanes (uint32_t* p, const Avx2Vec& x)
+  {
+    _mm256_storeu_si256 ((__m256i*) p, x.v);
+  }
+
+  static Avx2Vec is_zero (const Avx2Vec& x)
+  {
+    return make (_mm256_cmpeq_epi32 (x.v, _mm256_setzero_si256 ()));
+  }
+
+  static Avx2Vec rotate (const Avx2Vec& x)
+  {
+    return make (_mm256_shuffle_epi32 (x.v, _MM_SHUFFLE (3, 0, 2, 1)));
+  }
+
+  /// Adds the counters of the high digit to those of the low digit, and copies the result to both
+  static void reduce (Avx2Vec& ones, Avx2Vec& twos)
+  {
+    const __m256i o = _mm256_permute2x128_si256 (ones.v, ones.v, 0x01);
+    const __m256i t = _mm256_permute2x128_si256 (twos.v, twos.v, 0x01);
+
+    twos.v = _mm256_or_si256 (_mm256_or_si256 (twos.v, t), _mm256_and_si256 (ones.v, o));
+    ones.v = _mm256_or_si256 (ones.v, o);
+  }
+
+  bool any () const
+  {
+    return !_mm256_testz_si256 (v, v);
+  }
+
+  friend Avx2Vec operator& (const Avx2Vec& a, const Avx2Vec& b)
+  {
+    return make (_mm256_and_si256 (a.v, b.v));
+  }
+
+  friend Avx2Vec operator| (const Avx2Vec& a, const Avx2Vec& b)
+  {
+    return make (_mm256_or_si256 (a.v, b.v));
+  }
+
+  friend Avx2Vec operator>> (const Avx2Vec& a, const int n)
+  {
+    return make (_mm256_srli_epi32 (a.v, n));
+  }
+
+  friend Avx2Vec operator<< (const Avx2Vec& a, const int n)
+  {
+    return make (_mm256_slli_epi32 (a.v, n));
+  }
+
+  friend Avx2Vec andnot (const Avx2Vec& a, const Avx2Vec& b)
+  {
+    return make (_mm256_andnot_si256 (a.v, b.v));
+  }
+};
+
+}
+
+bool propagate_avx2 (BitboardSolver::State& state)
+{
+  return propagate_kernel<Avx2Vec> (state);
+}
+
+void propagate_batch_avx2 (BitboardSolver::State* states, const int count, bool* valid)
+{
+  propagate_batch_kernel<Avx2Vec> (states, count, valid);
+}
+#else
+bool propagate_avx2 (BitboardSolver::State& state)
+{
+  return propagate_kernel<PortableVec> (state);
+}
+
+void propagate_batch_avx2 (BitboardSolver::State* states, const int count, bool* valid)
+{
+  propagate_batch_kernel<PortableVec> (states, count, valid);
+}
+#endif
@@ -0,0 +1,260 @@
+/*
+ * File:   bitboard_batch.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Batch propagation kernel of the bitboard technique. Unlike the single-puzzle kernel, every vector
+ * lane holds a different puzzle: the states of V::LANES puzzles are transposed so that each band of
+ * each digit board becomes one vector, and naked and hidden singles are placed in all puzzles at
+ * once. Puzzles that get stuck are handed back for the regular search.
+ *
+ * Translation units that instantiate the kernel for a wider instruction set than the baseline must
+ * include this file only after enabling that instruction set.
+ */
+
+#ifndef BITBOARD_BATCH_HPP
+#define BITBOARD_BATCH_HPP
+
+#include "bitboard_kernel.hpp"
+
+/*! \brief Returns the widest batch kernel supported by the host CPU.
+ *
+ * \param width Receives the number of puzzles the kernel propagates at once.
+ *
+ * \return Selected kernel.
+ */
+BitboardSolver::BatchKernel select_batch_kernel (int& width);
+
+/*! \brief Kernel instantiations. Only call the ones supported by the host CPU.
+ */
+void propagate_batch_portable (BitboardSolver::State* states, const int count, bool* valid);
+void propagate_batch_sse2 (BitboardSolver::State* states, const int count, bool* valid);
+void propagate_batch_avx2 (BitboardSolver::State* states, const int count, bool* valid);
+
+//==================================================================================================
+//==================================================================================================
+
+/// Marks the cells that share a row, a column or a box with the given cells of a digit, and
+/// flags the units holding two or more of them
+template <class V>
+inline V mark_peers (const V* cells, V* peers)
+{
+  const V row_base = V::splat (BitboardSolver::ROW_BASE);
+  const V row_mask = V::splat (BitboardSolver::ROW_MASK);
+  const V box_base = V::splat (BitboardSolver::BOX_BASE);
+  V col_ones = V::splat (0);
+  V col_twos = V::splat (0);
+  V bad = V::splat (0);
+
+  for (int b = 0; b < 3; ++b)
+  {
+    V row_ones = V::splat (0);
+    V row_twos = V::splat (0);
+    V box_ones = V::splat (0);
+    V box_twos = V::splat (0);
+
+    for (int c = 0; c < 9; ++c)
+    {
+      const V y = (cells[b] >> c) & row_base;
+
+      row_twos = row_twos | (row_ones & y);
+      row_ones = row_ones | y;
+    }
+    for (int r = 0; r < 3; ++r)
+    {
+      const V z = (cells[b] >> (9 * r)) & row_mask;
+
+      col_twos = col_twos | (col_ones & z);
+      col_ones = col_ones | z;
+      for (int c = 0; c < 3; ++c)
+      {
+        const V y = (z >> c) & box_base;
+
+        box_twos = box_twos | (box_ones & y);
+        box_ones = box_ones | y;
+      }
+    }
+    bad = bad | row_twos | box_twos;
+    peers[b] = spread_rows (row_ones) | replicate_row (spread_boxes (box_ones));
+  }
+  for (int b = 0; b < 3; ++b)
+  {
+    peers[b] = peers[b] | replicate_row (col_ones);
+  }
+
+  return bad | col_twos;
+}
+
+template <class V>
+void propagate_batch_kernel (BitboardSolver::State* states, const int count, bool* valid)
+{
+  const int GRID_SIZE = 9;
+  const V band_mask = V::splat (BitboardSolver::BAND_MASK);
+  const V row_mask = V::splat (BitboardSolver::ROW_MASK);
+  const V row_base = V::splat (BitboardSolver::ROW_BASE);
+  const V box_base = V::splat (BitboardSolver::BOX_BASE);
+  uint32_t lanes[V::LANES];
+  V cand[GRID_SIZE][3];
+  V placed[GRID_SIZE][3];
+  V hits[GRID_SIZE][3];
+  V alive;
+
+  /// Transpose the states, unused lanes start out dead
+  for (int i = 0; i < V::LANES; ++i)
+  {
+    lanes[i] = (i < count ? 0 : 1);
+  }
+  alive = V::is_zero (V::load_lanes (lanes));
+  for (int d = 0; d < GRID_SIZE; ++d)
+  {
+    for (int b = 0; b < 3; ++b)
+    {
+      for (int i = 0; i < V::LANES; ++i)
+      {
+        lanes[i] = (i < count ? states[i].candidates[d].lane[b] : 0);
+      }
+      cand[d][b] = V::load_lanes (lanes);
+      for (int i = 0; i < V::LANES; ++i)
+      {
+        lanes[i] = (i < count ? states[i].placed[d].lane[b] : 0);
+      }
+      placed[d][b] = V::load_lanes (lanes);
+    }
+  }
+  for (;;)
+  {
+    V bad = V::splat (0);
+    V progress = V::splat (0);
+    V naked[3];
+
+    /// Naked singles, counted bit-sliced over the digits
+    for (int b = 0; b < 3; ++b)
+    {
+      V ones = V::splat (0);
+      V twos = V::splat (0);
+      V solved = V::splat (0);
+
+      for (int d = 0; d < GRID_SIZE; ++d)
+      {
+        twos = twos | (ones & cand[d][b]);
+        ones = ones | cand[d][b];
+        solved = solved | placed[d][b];
+      }
+      bad = bad | andnot (ones | solved, band_mask);
+      naked[b] = andnot (twos, ones);
+    }
+    /// Hidden singles of all rows, columns and boxes
+    for (int d = 0; d < GRID_SIZE; ++d)
+    {
+      V col_ones = V::splat (0);
+      V col_twos = V::splat (0);
+      V singles[3];
+
+      for (int b = 0; b < 3; ++b)
+      {
+        const V x = cand[d][b] | placed[d][b];
+        V row_ones = V::splat (0);
+        V row_twos = V::splat (0);
+        V box_ones = V::splat (0);
+        V box_twos = V::splat (0);
+
+        for (int c = 0; c < GRID_SIZE; ++c)
+        {
+          const V y = (x >> c) & row_base;
+
+          row_twos = row_twos | (row_ones & y);
+          row_ones = row_ones | y;
+        }
+        for (int r = 0; r < 3; ++r)
+        {
+          const V z = (x >> (GRID_SIZE * r)) & row_mask;
+
+          col_twos = col_twos | (col_ones & z);
+          col_ones = col_ones | z;
+          for (int c = 0; c < 3; ++c)
+          {
+            const V y = (z >> c) & box_base;
+
+            box_twos = box_twos | (box_ones & y);
+            box_ones = box_ones | y;
+          }
+        }
+        bad = bad | andnot (row_ones, row_base) | andnot (box_ones, box_base);
+        singles[b] = spread_rows (andnot (row_twos, row_ones)) | \
+        replicate_row (spread_boxes (andnot (box_twos, box_ones)));
+      }
+      bad = bad | andnot (col_ones, row_mask);
+      for (int b = 0; b < 3; ++b)
+      {
+        hits[d][b] = cand[d][b] & (naked[b] | singles[b] | \
+        replicate_row (andnot (col_twos, col_ones)));
+      }
+    }
+    /// Singles are placed all at once, which fails if a cell gets two digits or a unit gets the
+    /// same digit twice. Dead lanes are never updated again, so only live lanes make progress
+    V peers[GRID_SIZE][3];
+
+    for (int b = 0; b < 3; ++b)
+    {
+      V ones = V::splat (0);
+
+      for (int d = 0; d < GRID_SIZE; ++d)
+      {
+        bad = bad | (ones & hits[d][b]);
+        ones = ones | hits[d][b];
+      }
+      progress = progress | (ones & alive);
+    }
+    if (!progress.any ())
+    {
+      alive = alive & V::is_zero (bad);
+      break;
+    }
+    for (int d = 0; d < GRID_SIZE; ++d)
+    {
+      bad = bad | mark_peers (hits[d], peers[d]);
+    }
+    alive = alive & V::is_zero (bad);
+    for (int d = 0; d < GRID_SIZE; ++d)
+    {
+      for (int b = 0; b < 3; ++b)
+      {
+        const V h = hits[d][b] & alive;
+
+        placed[d][b] = placed[d][b] | h;
+        cand[d][b] = andnot (peers[d][b] & alive, cand[d][b]);
+        for (int e = 0; e < GRID_SIZE; ++e)
+        {
+          cand[e][b] = andnot (h, cand[e][b]);
+        }
+      }
+    }
+  }
+  /// Transpose back
+  for (int d = 0; d < GRID_SIZE; ++d)
+  {
+    for (int b = 0; b < 3; ++b)
+    {
+      V::store_lanes (lanes, cand[d][b]);
+      for (int i = 0; i < count; ++i)
+      {
+        states[i].candidates[d].lane[b] = lanes[i];
+      }
+      V::store_lanes (lanes, placed[d][b]);
+      for (int i = 0; i < count; ++i)
+      {
+        states[i].placed[d].lane[b] = lanes[i];
+        states[i].solved.lane[b] = (d == 0 ? 0 : states[i].solved.lane[b]) | lanes[i];
+      }
+    }
+  }
+  V::store_lanes (lanes, alive);
+  for (int i = 0; i < count; ++i)
+  {
+    valid[i] = (lanes[i] != 0);
+  }
+}
+
+#endif /// BITBOARD_BATCH_HPP
@@ -0,0 +1,386 @@
+/*
+ * File:   bitboard_kernel.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Vectorized propagation kernel of the bitboard technique. The kernel is written once against a
+ * small vector interface and instantiated for portable scalar code, SSE2 and AVX2. A vector holds
+ * V::DIGITS digit boards side by side, and the three bands of a board are processed in parallel
+ * lanes. On top of naked and hidden singles, the kernel applies locked candidates (pointing and
+ * claiming along rows and columns) whenever no single is left.
+ *
+ * Translation units that instantiate the kernel for a wider instruction set than the baseline must
+ * include this file only after enabling that instruction set.
+ */
+
+#ifndef BITBOARD_KERNEL_HPP
+#define BITBOARD_KERNEL_HPP
+
+#include "bitboard_propagation.hpp"
+
+/*! \brief Returns the fastest vectorized kernel supported by the host CPU.
+ *
+ * \param name Receives the name of the selected kernel.
+ *
+ * \return Selected kernel.
+ */
+BitboardSolver::Kernel select_kernel (const char*& name);
+
+/*! \brief Kernel instantiations. Only call the ones supported by the host CPU.
+ */
+bool propagate_portable (BitboardSolver::State& state);
+bool propagate_sse2 (BitboardSolver::State& state);
+bool propagate_avx2 (BitboardSolver::State& state);
+
+//==================================================================================================
+//==================================================================================================
+
+/*! \brief Portable vector of one digit board, one band per lane. The batch kernel instead uses
+ * each of the LANES lanes for a different puzzle.
+ */
+struct PortableVec
+{
+  static const int DIGITS = 1;
+  static const int LANES = 4;
+  uint32_t v[4];
+
+  static PortableVec load (const Bitboard* p)
+  {
+    PortableVec x = {{p->lane[0], p->lane[1], p->lane[2], p->lane[3]}};
+    return x;
+  }
+
+  static void store (Bitboard* p, const PortableVec& x, const int)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      p->lane[i] = x.v[i];
+    }
+  }
+
+  static PortableVec band (const uint32_t c)
+  {
+    PortableVec x = {{c, c, c, 0}};
+    return x;
+  }
+
+  static PortableVec broadcast (const Bitboard& b)
+  {
+    return load (&b);
+  }
+
+  static PortableVec splat (const uint32_t c)
+  {
+    PortableVec x = {{c, c, c, c}};
+    return x;
+  }
+
+  static PortableVec load_lanes (const uint32_t* p)
+  {
+    PortableVec x = {{p[0], p[1], p[2], p[3]}};
+    return x;
+  }
+
+  static void store_lanes (uint32_t* p, const PortableVec& x)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      p[i] = x.v[i];
+    }
+  }
+
+  /// Sets the lanes that are zero to all ones, and the others to zero
+  static PortableVec is_zero (const PortableVec& x)
+  {
+    PortableVec y;
+
+    for (int i = 0; i < 4; ++i)
+    {
+      y.v[i] = (x.v[i] ? 0u : ~0u);
+    }
+    return y;
+  }
+
+  /// Moves band i + 1 into lane i, wrapping around over the three bands
+  static PortableVec rotate (const PortableVec& x)
+  {
+    PortableVec y = {{x.v[1], x.v[2], x.v[0], x.v[3]}};
+    return y;
+  }
+
+  /// Merges the bit-sliced counters of the digits held side by side
+  static void reduce (PortableVec&, PortableVec&)
+  {}
+
+  bool any () const
+  {
+    return (v[0] | v[1] | v[2] | v[3]) != 0;
+  }
+
+  friend PortableVec operator& (const PortableVec& a, const PortableVec& b)
+  {
+    PortableVec x = {{a.v[0] & b.v[0], a.v[1] & b.v[1], a.v[2] & b.v[2], a.v[3] & b.v[3]}};
+    return x;
+  }
+
+  friend PortableVec operator| (const PortableVec& a, const PortableVec& b)
+  {
+    PortableVec x = {{a.v[0] | b.v[0], a.v[1] | b.v[1], a.v[2] | b.v[2], a.v[3] | b.v[3]}};
+    return x;
+  }
+
+  friend PortableVec operator>> (const PortableVec& a, const int n)
+  {
+    PortableVec x = {{a.v[0] >> n, a.v[1] >> n, a.v[2] >> n, a.v[3] >> n}};
+    return x;
+  }
+
+  friend PortableVec operator<< (const PortableVec& a, const int n)
+  {
+    PortableVec x = {{a.v[0] << n, a.v[1] << n, a.v[2] << n, a.v[3] << n}};
+    return x;
+  }
+
+  /// Returns ~a & b
+  friend PortableVec andnot (const PortableVec& a, const PortableVec& b)
+  {
+    PortableVec x = {{~a.v[0] & b.v[0], ~a.v[1] & b.v[1], ~a.v[2] & b.v[2], ~a.v[3] & b.v[3]}};
+    return x;
+  }
+};
+
+//==================================================================================================
+//==================================================================================================
+
+/// Spreads bits 0, 9 and 18 over their whole row
+template <class V>
+inline V spread_rows (const V& x)
+{
+  V t = x | (x << 1);
+
+  t = t | (t << 2);
+  t = t | (t << 4);
+
+  return t | (x << 8);
+}
+
+/// Spreads bits 0, 3 and 6 over the three columns of their box
+template <class V>
+inline V spread_boxes (const V& x)
+{
+  return x | (x << 1) | (x << 2);
+}
+
+/// Copies the first row of a band to its two other rows
+template <class V>
+inline V replicate_row (const V& x)
+{
+  return x | (x << 9) | (x << 18);
+}
+
+template <class V>
+bool propagate_kernel (BitboardSolver::State& state)
+{
+  const int GRID_SIZE = 9;
+  const int GROUPS = (GRID_SIZE + V::DIGITS - 1) / V::DIGITS;
+  const V band_mask = V::band (BitboardSolver::BAND_MASK);
+  const V row_mask = V::band (BitboardSolver::ROW_MASK);
+  const V row_base = V::band (BitboardSolver::ROW_BASE);
+  const V box_base = V::band (BitboardSolver::BOX_BASE);
+  const V seg_base = V::band (0x1249249);
+  const V one = V::band (1);
+  /// Boards are padded to a whole number of vectors with a digit that has no candidates and
+  /// is placed everywhere, so it never yields a single nor a contradiction
+  Bitboard cand[GRID_SIZE + 1];
+  Bitboard known[GRID_SIZE + 1];
+  Bitboard hits[GRID_SIZE + 1];
+
+  for (int l = 0; l < 4; ++l)
+  {
+    cand[GRID_SIZE].lane[l] = 0;
+    known[GRID_SIZE].lane[l] = (l < 3 ? BitboardSolver::BAND_MASK : 0);
+  }
+  for (;;)
+  {
+    V ones = V::band (0);
+    V twos = V::band (0);
+    bool found = false;
+
+    for (int d = 0; d < GRID_SIZE; ++d)
+    {
+      cand[d] = state.candidates[d];
+      for (int l = 0; l < 4; ++l)
+      {
+        known[d].lane[l] = state.candidates[d].lane[l] | state.placed[d].lane[l];
+      }
+    }
+    /// Naked singles, counted bit-sliced over the digits
+    for (int g = 0; g < GROUPS; ++g)
+    {
+      const V c = V::load (&cand[g * V::DIGITS]);
+
+      twos = twos | (ones & c);
+      ones = ones | c;
+    }
+    V::reduce (ones, twos);
+    if (andnot (ones | V::broadcast (state.solved), band_mask).any ())
+    {
+      return false;
+    }
+    const V naked = andnot (twos, ones);
+
+    /// Hidden singles of all rows, columns and boxes
+    for (int g = 0; g < GROUPS; ++g)
+    {
+      const V x = V::load (&known[g * V::DIGITS]);
+      V row_ones = V::band (0);
+      V row_twos = V::band (0);
+      V box_ones = V::band (0);
+      V box_twos = V::band (0);
+      V col_ones = V::band (0);
+      V col_twos = V::band (0);
+
+      for (int c = 0; c < GRID_SIZE; ++c)
+      {
+        const V y = (x >> c) & row_base;
+
+        row_twos = row_twos | (row_ones & y);
+        row_ones = row_ones | y;
+      }
+      for (int r = 0; r < 3; ++r)
+      {
+        const V z = (x >> (GRID_SIZE * r)) & row_mask;
+
+        col_twos = col_twos | (col_ones & z);
+        col_ones = col_ones | z;
+        for (int c = 0; c < 3; ++c)
+        {
+          const V y = (z >> c) & box_base;
+
+          box_twos = box_twos | (box_ones & y);
+          box_ones = box_ones | y;
+        }
+      }
+      /// Columns span the three bands, so merge the per-band counters across lanes
+      const V o1 = V::rotate (col_ones);
+      const V o2 = V::rotate (o1);
+      const V t1 = V::rotate (col_twos);
+      const V t2 = V::rotate (t1);
+
+      col_twos = col_twos | t1 | t2 | (col_ones & o1) | (col_ones & o2) | (o1 & o2);
+      col_ones = col_ones | o1 | o2;
+      if (andnot (row_ones, row_base).any () || andnot (box_ones, box_base).any () || \
+        andnot (col_ones, row_mask).any ())
+      {
+        return false;
+      }
+      const V singles = spread_rows (andnot (row_twos, row_ones)) | \
+      replicate_row (spread_boxes (andnot (box_twos, box_ones))) | \
+      replicate_row (andnot (col_twos, col_ones));
+      const V h = V::load (&cand[g * V::DIGITS]) & (naked | singles);
+
+      V::store (&hits[g * V::DIGITS], h, V::DIGITS);
+      found = found || h.any ();
+    }
+    if (found)
+    {
+      for (int d = 0; d < GRID_SIZE; ++d)
+      {
+        for (int l = 0; l < 3; ++l)
+        {
+          uint32_t bits = hits[d].lane[l];
+
+          while (bits != 0)
+          {
+            const uint32_t m = bits & -bits;
+
+            /// An earlier placement may have taken the cell, the next round detects it
+            if (state.candidates[d].lane[l] & m)
+            {
+              BitboardSolver::place (state, l * 27 + __builtin_ctz (m), d);
+            }
+            bits &= bits - 1;
+          }
+        }
+      }
+      continue;
+    }
+    /// Locked candidates
+    for (int g = 0; g < GROUPS; ++g)
+    {
+      const V c = V::load (&cand[g * V::DIGITS]);
+      /// Presence of the digit in each row segment of a box (bits 0, 3, ..., 24)
+      const V seg = (c | (c >> 1) | (c >> 2)) & seg_base;
+      /// Presence of the digit in each column of the band (bits 0 to 8)
+      const V cols = (c | (c >> 9) | (c >> 18)) & row_mask;
+      V elim = V::band (0);
+      V ones_1 = V::band (0);
+      V twos_1 = V::band (0);
+      V ones_2 = V::band (0);
+      V twos_2 = V::band (0);
+      V ones_3 = V::band (0);
+      V twos_3 = V::band (0);
+
+      for (int i = 0; i < 3; ++i)
+      {
+        const V rows_of_boxes = (seg >> (9 * i)) & box_base;
+        const V boxes_of_rows = (seg >> (3 * i)) & row_base;
+        const V cols_of_boxes = (cols >> i) & box_base;
+
+        twos_1 = twos_1 | (ones_1 & rows_of_boxes);
+        ones_1 = ones_1 | rows_of_boxes;
+        twos_2 = twos_2 | (ones_2 & boxes_of_rows);
+        ones_2 = ones_2 | boxes_of_rows;
+        twos_3 = twos_3 | (ones_3 & cols_of_boxes);
+        ones_3 = ones_3 | cols_of_boxes;
+      }
+      /// Boxes confined to one row, rows confined to one box, boxes confined to one column
+      const V box_in_row = andnot (twos_1, ones_1);
+      const V row_in_box = andnot (twos_2, ones_2);
+      const V box_in_col = andnot (twos_3, ones_3);
+      V pointing_cols = V::band (0);
+
+      for (int i = 0; i < 3; ++i)
+      {
+        /// Pointing along row i: clear the rest of the row
+        const V q = box_in_row & ((seg >> (9 * i)) & box_base);
+        const V any_row = spread_rows ((q | (q >> 3) | (q >> 6)) & one);
+
+        elim = elim | (andnot (spread_boxes (q), any_row) << (9 * i));
+        /// Claiming within box i: clear the other rows of the box
+        const V p = row_in_box & ((seg >> (3 * i)) & row_base);
+        const V any_box = (p | (p >> 9) | (p >> 18)) & one;
+
+        elim = elim | andnot (spread_rows (p), replicate_row (spread_boxes (any_box << (3 * i))));
+        /// Pointing along columns: column 3j + i holds box j's only candidates
+        pointing_cols = pointing_cols | ((box_in_col & ((cols >> i) & box_base)) << i);
+      }
+      /// A column pointed by one band is cleared in the other two
+      const V p1 = V::rotate (pointing_cols);
+
+      elim = elim | replicate_row (p1 | V::rotate (p1));
+      /// Claiming along columns: a column held by a single band clears the rest of its box
+      const V c1 = V::rotate (cols);
+      const V c2 = V::rotate (c1);
+      const V claimed = andnot (c1 | c2, cols);
+      const V claimed_boxes = (claimed | (claimed >> 1) | (claimed >> 2)) & box_base;
+
+      elim = elim | replicate_row (andnot (claimed, spread_boxes (claimed_boxes)));
+      elim = elim & band_mask & c;
+      if (elim.any ())
+      {
+        V::store (&state.candidates[g * V::DIGITS], andnot (elim, c), \
+        GRID_SIZE - g * V::DIGITS < V::DIGITS ? GRID_SIZE - g * V::DIGITS : V::DIGITS);
+        found = true;
+      }
+    }
+    if (!found)
+    {
+      return true;
+    }
+  }
+}
+
+#endif /// BITBOARD_KERNEL_HPP
@@ -0,0 +1,466 @@
+/*
+ * File:   bitboard_propagation.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * This sudoku solving technique performs the same naked single and hidden single propagation as
+ * the constraint propagation technique, but on bitboards.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <string.h>
+
+#include "bitboard_propagation.hpp"
+#include "bitboard_batch.hpp"
+
+static const int GRID_SIZE = 9;
+static const int CELLS = GRID_SIZE * GRID_SIZE;
+static const int BANDS = 3;
+
+Bitboard BitboardSolver::peers_[CELLS];
+
+static inline int lane_of (const int k)
+{
+  return k / 27;
+}
+
+static inline uint32_t bit_of (const int k)
+{
+  return 1u << (k % 27);
+}
+
+BitboardSolver::BitboardSolver ():
+  propagate_ (&BitboardSolver::propagate),
+  propagate_batch_ (NULL),
+  batch_width_ (0),
+  kernel_name_ ("scalar"),
+  limits_ (NULL),
+  solution_limit_ (1),
+  solution_count_ (0),
+  timed_out_ (false),
+  quiet_ (false),
+  depth_ (0)
+{
+  memset (&solution_, 0, sizeof (solution_));
+  propagate_batch_ = select_batch_kernel (batch_width_);
+}
+
+void BitboardSolver::init ()
+{
+  for (int k = 0; k < CELLS; ++k)
+  {
+    const int r = k / GRID_SIZE;
+    const int c = k % GRID_SIZE;
+
+    memset (&peers_[k], 0, sizeof (Bitboard));
+    for (int p = 0; p < CELLS; ++p)
+    {
+      const int pr = p / GRID_SIZE;
+      const int pc = p % GRID_SIZE;
+
+      if (p != k && (pr == r || pc == c || (pr / 3 == r / 3 && pc / 3 == c / 3)))
+      {
+        peers_[k].lane[lane_of (p)] |= bit_of (p);
+      }
+    }
+  }
+}
+
+void BitboardSolver::set_vectorized (const bool flag)
+{
+  if (flag)
+  {
+    propagate_ = select_kernel (kernel_name_);
+  }
+  else
+  {
+    propagate_ = &BitboardSolver::propagate;
+    kernel_name_ = "scalar";
+  }
+}
+
+const char* BitboardSolver::kernel_name () const
+{
+  return kernel_name_;
+}
+
+void BitboardSolver::solve (const std::vector <std::vector <int> >& input_grid,
+  SearchLimits* limits)
+{
+  State state;
+
+  solution_count_ = 0;
+  timed_out_ = false;
+  if (load (input_grid, state, quiet_))
+  {
+    if (limits != NULL)
+    {
+      limits->lap (PhaseTimes::SETUP);
+    }
+    solve (state, limits);
+  }
+}
+
+bool BitboardSolver::load (const std::vector <std::vector <int> >& input_grid, State& state,
+  const bool quiet)
+{
+  int val = 0;
+
+  memset (&state, 0, sizeof (state));
+  for (int d = 0; d < GRID_SIZE; ++d)
+  {
+    for (int l = 0; l < BANDS; ++l)
+    {
+      state.candidates[d].lane[l] = BAND_MASK;
+    }
+  }
+  for (int i = 0; i < GRID_SIZE; ++i)
+  {
+    for (int j = 0; j < GRID_SIZE; ++j)
+    {
+      val = input_grid[i][j];
+      if (val > GRID_SIZE || val < 0)
+      {
+        if (!quiet)
+        {
+          std::cout << "ERROR! Invalid puzzle specified." << std::endl;
+        }
+        return false;
+      }
+      if (val != 0)
+      {
+        const int k = i * GRID_SIZE + j;
+
+        if (!(state.candidates[val - 1].lane[lane_of (k)] & bit_of (k)))
+        {
+          if (!quiet)
+          {
+            std::cerr << "ERROR! Repeated or invalid value '" << val \
+            << "' in puzzle at row: " << i + 1 << ", column: " << j + 1 << "." << std::endl;
+          }
+          return false;
+        }
+        place (state, k, val - 1);
+      }
+    }
+  }
+
+  return true;
+}
+
+void BitboardSolver::solve (const State& state, SearchLimits* limits)
+{
+  State start = state;
+
+  solution_count_ = 0;
+  timed_out_ = false;
+  limits_ = limits;
+  stats_.clear ();
+  depth_ = 0;
+  /// States already solved by batch propagation need no further work
+  if (complete (start) || propagate_ (start))
+  {
+    stats_.propagations += solved_count (start) - solved_count (state);
+    if (limits_ != NULL)
+    {
+      limits_->lap (PhaseTimes::PROPAGATE);
+    }
+    search (start);
+  }
+  if (limits_ != NULL)
+  {
+    limits_->stats ().add (stats_);
+  }
+  if (timed_out_ && !quiet_)
+  {
+    std::cout << "Puzzle search exceeded its time or node limit." << std::endl;
+  }
+  else if (solution_count_ == 0 && !quiet_)
+  {
+    std::cout << "Puzzle is not solvable." << std::endl;
+  }
+  limits_ = NULL;
+}
+
+int BitboardSolver::batch_width () const
+{
+  return batch_width_;
+}
+
+void BitboardSolver::propagate_batch (State* states, const int count, bool* valid) const
+{
+  for (int i = 0; i < count; i += batch_width_)
+  {
+    propagate_batch_ (states + i, std::min (batch_width_, count - i), valid + i);
+  }
+}
+
+void BitboardSolver::set_solution_limit (const int limit)
+{
+  solution_limit_ = (limit > 0 ? limit : 1);
+}
+
+void BitboardSolver::set_quiet (const bool flag)
+{
+  quiet_ = flag;
+}
+
+int BitboardSolver::solution_count () const
+{
+  return solution_count_;
+}
+
+bool BitboardSolver::is_solved () const
+{
+  return solution_count_ > 0;
+}
+
+bool BitboardSolver::is_timed_out () const
+{
+  return timed_out_;
+}
+
+void BitboardSolver::output (std::vector <std::vector <int> >& output_grid) const
+{
+  for (int d = 0; d < GRID_SIZE; ++d)
+  {
+    for (int l = 0; l < BANDS; ++l)
+    {
+      uint32_t bits = solution_.placed[d].lane[l];
+
+      while (bits != 0)
+      {
+        const int k = l * 27 + __builtin_ctz (bits);
+
+        output_grid[k / GRID_SIZE][k % GRID_SIZE] = d + 1;
+        bits &= bits - 1;
+      }
+    }
+  }
+}
+
+void BitboardSolver::place (State& state, const int k, const int d)
+{
+  const int l = lane_of (k);
+  const uint32_t m = bit_of (k);
+
+  for (int e = 0; e < GRID_SIZE; ++e)
+  {
+    state.candidates[e].lane[l] &= ~m;
+  }
+  for (int i = 0; i < BANDS; ++i)
+  {
+    state.candidates[d].lane[i] &= ~peers_[k].lane[i];
+  }
+  state.placed[d].lane[l] |= m;
+  state.solved.lane[l] |= m;
+}
+
+bool BitboardSolver::propagate (State& state)
+{
+  uint32_t naked[BANDS];
+  uint32_t singles[BANDS];
+  bool changed = true;
+
+  while (changed)
+  {
+    changed = false;
+    /// Naked singles: cells holding exactly one candidate, counted bit-sliced over the digits
+    for (int l = 0; l < BANDS; ++l)
+    {
+      uint32_t ones = 0;
+      uint32_t twos = 0;
+
+      for (int d = 0; d < GRID_SIZE; ++d)
+      {
+        twos |= ones & state.candidates[d].lane[l];
+        ones |= state.candidates[d].lane[l];
+      }
+      if (~(ones | state.solved.lane[l]) & BAND_MASK)
+      {
+        return false;
+      }
+      naked[l] = ones & ~twos;
+    }
+    /// Hidden singles: units where a digit has exactly one place left
+    for (int d = 0; d < GRID_SIZE; ++d)
+    {
+      uint32_t col_ones = 0;
+      uint32_t col_twos = 0;
+
+      for (int l = 0; l < BANDS; ++l)
+      {
+        const uint32_t x = state.candidates[d].lane[l] | state.placed[d].lane[l];
+        uint32_t row_ones = 0;
+        uint32_t row_twos = 0;
+        uint32_t box_ones = 0;
+        uint32_t box_twos = 0;
+
+        for (int c = 0; c < GRID_SIZE; ++c)
+        {
+          const uint32_t y = (x >> c) & ROW_BASE;
+
+          row_twos |= row_ones & y;
+          row_ones |= y;
+        }
+        for (int r = 0; r < 3; ++r)
+        {
+          const uint32_t z = (x >> (GRID_SIZE * r)) & ROW_MASK;
+
+          col_twos |= col_ones & z;
+          col_ones |= z;
+          for (int c = 0; c < 3; ++c)
+          {
+            const uint32_t y = (z >> c) & BOX_BASE;
+
+            box_twos |= box_ones & y;
+            box_ones |= y;
+          }
+        }
+        if ((~row_ones & ROW_BASE) || (~box_ones & BOX_BASE))
+        {
+          return false;
+        }
+        const uint32_t box = (box_ones & ~box_twos) * 0x7;
+
+        singles[l] = ((row_ones & ~row_twos) * ROW_MASK) | (box * ROW_BASE);
+      }
+      if (~col_ones & ROW_MASK)
+      {
+        return false;
+      }
+      for (int l = 0; l < BANDS; ++l)
+      {
+        uint32_t hits = ((col_ones & ~col_twos) * ROW_BASE | singles[l] | naked[l]) & \
+        state.candidates[d].lane[l];
+
+        while (hits != 0)
+        {
+          const uint32_t m = hits & -hits;
+
+          /// An earlier placement may have taken the cell, the next round detects it
+          if (state.candidates[d].lane[l] & m)
+          {
+            place (state, l * 27 + __builtin_ctz (m), d);
+            changed = true;
+          }
+          hits &= hits - 1;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+bool BitboardSolver::complete (const State& state)
+{
+  return (state.solved.lane[0] & state.solved.lane[1] & state.solved.lane[2]) == BAND_MASK;
+}
+
+int BitboardSolver::solved_count (const State& state)
+{
+  return __builtin_popcount (state.solved.lane[0]) + __builtin_popcount (state.solved.lane[1]) + \
+  __builtin_popcount (state.solved.lane[2]);
+}
+
+int BitboardSolver::pick_cell (const State& state)
+{
+  int best = -1;
+  int min = GRID_SIZE + 1;
+
+  /// Cells with exactly two candidates are the best possible choice
+  for (int l = 0; l < BANDS; ++l)
+  {
+    uint32_t ones = 0;
+    uint32_t twos = 0;
+    uint32_t threes = 0;
+
+    for (int d = 0; d < GRID_SIZE; ++d)
+    {
+      threes |= twos & state.candidates[d].lane[l];
+      twos |= ones & state.candidates[d].lane[l];
+      ones |= state.candidates[d].lane[l];
+    }
+    if (twos & ~threes)
+    {
+      return l * 27 + __builtin_ctz (twos & ~threes);
+    }
+  }
+  for (int k = 0; k < CELLS; ++k)
+  {
+    const int l = lane_of (k);
+    const uint32_t m = bit_of (k);
+    int n = 0;
+
+    if (state.solved.lane[l] & m)
+    {
+      continue;
+    }
+    for (int d = 0; d < GRID_SIZE; ++d)
+    {
+      n += (state.candidates[d].lane[l] & m) ? 1 : 0;
+    }
+    if (n < min)
+    {
+      min = n;
+      best = k;
+    }
+  }
+
+  return best;
+}
+
+bool BitboardSolver::search (const State& state)
+{
+  if (complete (state))
+  {
+    if (solution_count_ == 0)
+    {
+      solution_ = state;
+    }
+    ++solution_count_;
+    return solution_count_ >= solution_limit_;
+  }
+  if (limits_ != NULL && !limits_->tick ())
+  {
+    timed_out_ = true;
+    return true;
+  }
+  const int k = pick_cell (state);
+  const int l = lane_of (k);
+  const uint32_t m = bit_of (k);
+  int count = 0;
+
+  for (int d = 0; d < GRID_SIZE; ++d)
+  {
+    count += (state.candidates[d].lane[l] & m) ? 1 : 0;
+  }
+  stats_.branch (count, depth_ + 1);
+  for (int d = 0; d < GRID_SIZE; ++d)
+  {
+    if (state.candidates[d].lane[l] & m)
+    {
+      State next = state;
+
+      place (next, k, d);
+
+      const bool alive = propagate_ (next);
+
+      stats_.guess (solved_count (next) - solved_count (state) - 1);
+      ++depth_;
+      if (alive && search (next))
+      {
+        --depth_;
+        return true;
+      }
+      --depth_;
+      ++stats_.backtracks;
+    }
+  }
+
+  return false;
+}
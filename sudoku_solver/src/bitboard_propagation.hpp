@@ -0,0 +1,224 @@
+/*
+ * File:   bitboard_propagation.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * This sudoku solving technique performs the same naked single and hidden single propagation as
+ * the constraint propagation technique, but on bitboards. Every digit has a 128-bit board marking
+ * the cells where it is still a candidate, so a single pass of bitwise operations finds the
+ * singles of all rows, columns and boxes at once.
+ *
+ * A 9x9 grid is laid out as four 32-bit lanes. Lane b holds band b (rows 3b to 3b+2), cell (r, c)
+ * being bit 9 * (r % 3) + c of its lane. The fourth lane is unused.
+ */
+
+#ifndef BITBOARD_PROPAGATION_HPP
+#define BITBOARD_PROPAGATION_HPP
+
+#include <vector>
+#include <stdint.h>
+
+#include "search_limits.hpp"
+
+struct Bitboard
+{
+  uint32_t lane[4];
+};
+
+//==================================================================================================
+//==================================================================================================
+
+class BitboardSolver
+{
+public:
+  struct State
+  {
+    Bitboard candidates[9];
+    Bitboard placed[9];
+    Bitboard solved;
+  };
+
+  /// Propagation kernel. Returns false if the state turned out to be contradictory.
+  typedef bool (*Kernel) (State& state);
+
+  /// Batch propagation kernel. Propagates count states at once, one per vector lane, and sets
+  /// valid[i] to false if state i turned out to be contradictory.
+  typedef void (*BatchKernel) (State* states, const int count, bool* valid);
+
+  /// All 27 cells of a band
+  static const uint32_t BAND_MASK = 0x7FFFFFF;
+  /// All 9 cells of the first row of a band
+  static const uint32_t ROW_MASK = 0x1FF;
+  /// First cell of each row of a band
+  static const uint32_t ROW_BASE = 0x40201;
+  /// First cell of each box in the first row of a band
+  static const uint32_t BOX_BASE = 0x49;
+
+  BitboardSolver ();
+
+  /*! \brief Initializes the peer bitboards shared by all instances.
+   */
+  static void init ();
+
+  /*! \brief Selects between the scalar singles-only kernel and the vectorized kernel, which
+   * also applies locked candidates. The vectorized kernel uses the widest instruction set
+   * supported by the host, as detected at runtime.
+   *
+   * \param flag Toggle flag.
+   */
+  void set_vectorized (const bool flag);
+
+  /*! \brief Returns the name of the propagation kernel in use.
+   *
+   * \return Kernel name.
+   */
+  const char* kernel_name () const;
+
+  /*! \brief Places a digit in a cell and removes it from the candidates of the cell's peers.
+   *
+   * \param state Search state.
+   * \param k Cell index of type int.
+   * \param d Digit index (0-based) of type int.
+   */
+  static void place (State& state, const int k, const int d);
+
+  /*! \brief Solves a sudoku puzzle.
+   *
+   * \param input_grid Sudoku puzzle to solve of type std::vector <std::vector<int> >.
+   * \param limits Optional search budget. The search is abandoned once it expires.
+   */
+  void solve (const std::vector <std::vector <int> >& input_grid, SearchLimits* limits = NULL);
+
+  /*! \brief Fills a search state with the clues of a puzzle, without propagating them.
+   *
+   * \param input_grid Sudoku puzzle of type std::vector <std::vector<int> >.
+   * \param state Resulting search state.
+   * \param quiet Keeps invalid and repeated values from being reported on the console.
+   *
+   * \return false if the puzzle holds an invalid or repeated value, true otherwise.
+   */
+  static bool load (const std::vector <std::vector <int> >& input_grid, State& state,
+    const bool quiet = false);
+
+  /*! \brief Solves a puzzle from a state whose clues are placed, e.g. one that has been through
+   * batch propagation. The result is the same as solving the original puzzle.
+   *
+   * \param state Non-contradictory search state.
+   * \param limits Optional search budget. The search is abandoned once it expires.
+   */
+  void solve (const State& state, SearchLimits* limits = NULL);
+
+  /*! \brief Returns the number of puzzles the batch kernel propagates at once.
+   *
+   * \return Batch width of type int.
+   */
+  int batch_width () const;
+
+  /*! \brief Places the naked and hidden singles of up to batch_width () states at once. States
+   * that still need branching are left for solve ().
+   *
+   * \param states Search states.
+   * \param count Number of states of type int.
+   * \param valid Receives false for each state that turned out to be contradictory.
+   */
+  void propagate_batch (State* states, const int count, bool* valid) const;
+
+  /*! \brief Sets the number of solutions to look for before the search stops.
+   *
+   * \param limit Solution limit of type int.
+   */
+  void set_solution_limit (const int limit);
+
+  /*! \brief Keeps the solver from reporting invalid and unsolvable puzzles on the console.
+   *
+   * \param flag Toggle flag.
+   */
+  void set_quiet (const bool flag);
+
+  /*! \brief Returns the number of solutions found for the current puzzle, up to the limit.
+   *
+   * \return Solution count of type int.
+   */
+  int solution_count () const;
+
+  /*! \brief Returns the status of the current puzzle.
+   *
+   * \return Returns true if puzzle was successfully solved, false otherwise.
+   */
+  bool is_solved () const;
+
+  /*! \brief Returns whether the search of the current puzzle was abandoned due to its limits.
+   *
+   * \return Returns true if the search budget expired, false otherwise.
+   */
+  bool is_timed_out () const;
+
+  /*! \brief Copies the puzzle's solution to the final container.
+   *
+   * \param output_grid Solved Sudoku puzzle of type std::vector <std::vector<int> >.
+   */
+  void output (std::vector <std::vector <int> >& output_grid) const;
+
+private:
+  friend struct CrossCheck;
+
+  State solution_;
+  Kernel propagate_;
+  BatchKernel propagate_batch_;
+  int batch_width_;
+  const char* kernel_name_;
+  SearchLimits* limits_;
+  int solution_limit_;
+  int solution_count_;
+  bool timed_out_;
+  bool quiet_;
+  /// Effort of the current puzzle, added to the statistics of limits_ once it is over
+  SearchStats stats_;
+  /// Number of guesses on the current path
+  int depth_;
+  static Bitboard peers_[81];
+
+  /*! \brief Places naked and hidden singles until none is left. This is the scalar kernel.
+   *
+   * \param state Search state.
+   *
+   * \return Status of type bool. false if the state turned out to be contradictory.
+   */
+  static bool propagate (State& state);
+
+  /*! \brief Returns whether every cell of a state holds a digit.
+   *
+   * \param state Search state.
+   *
+   * \return Status of type bool.
+   */
+  static bool complete (const State& state);
+
+  /*! \brief Returns the number of cells of a state that hold a digit.
+   *
+   * \param state Search state.
+   *
+   * \return Cell count of type int.
+   */
+  static int solved_count (const State& state);
+
+  /*! \brief Picks the unsolved cell with the fewest candidates.
+   *
+   * \param state Search state.
+   *
+   * \return Cell index of type int.
+   */
+  static int pick_cell (const State& state);
+
+  /*! \brief Depth-first search over propagated states.
+   *
+   * \param state Search state.
+   *
+   * \return true if the solution limit has been reached or the search must stop.
+   */
+  bool search (const State& state);
+};
+
+#endif /// BITBOARD_PROPAGATION_HPP
@@ -0,0 +1,168 @@
+/*
+ * File:   bitboard_simd.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Portable and SSE2 instantiations of the vectorized bitboard kernels, and runtime selection of the
+ * widest kernels supported by the host CPU.
+ */
+
+#include "bitboard_batch.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+/*! \brief SSE2 vector of one digit board, one band per 32-bit lane.
+ */
+struct Sse2Vec
+{
+  static const int DIGITS = 1;
+  static const int LANES = 4;
+  __m128i v;
+
+  static Sse2Vec make (const __m128i x)
+  {
+    Sse2Vec y;
+    y.v = x;
+    return y;
+  }
+
+  static Sse2Vec load (const Bitboard* p)
+  {
+    return make (_mm_loadu_si128 ((const __m128i*) p));
+  }
+
+  static void store (Bitboard* p, const Sse2Vec& x, const int)
+  {
+    _mm_storeu_si128 ((__m128i*) p, x.v);
+  }
+
+  static Sse2Vec band (const uint32_t c)
+  {
+    return make (_mm_set_epi32 (0, c, c, c));
+  }
+
+  static Sse2Vec broadcast (const Bitboard& b)
+  {
+    return load (&b);
+  }
+
+  static Sse2Vec splat (const uint32_t c)
+  {
+    return make (_mm_set1_epi32 (c));
+  }
+
+  static Sse2Vec load_lanes (const uint32_t* p)
+  {
+    return make (_mm_loadu_si128 ((const __m128i*) p));
+  }
+
+  static void store_lanes (uint32_t* p, const Sse2Vec& x)
+  {
+    _mm_storeu_si128 ((__m128i*) p, x.v);
+  }
+
+  static Sse2Vec is_zero (const Sse2Vec& x)
+  {
+    return make (_mm_cmpeq_epi32 (x.v, _mm_setzero_si128 ()));
+  }
+
+  static Sse2Vec rotate (const Sse2Vec& x)
+  {
+    return make (_mm_shuffle_epi32 (x.v, _MM_SHUFFLE (3, 0, 2, 1)));
+  }
+
+  static void reduce (Sse2Vec&, Sse2Vec&)
+  {}
+
+  bool any () const
+  {
+    return _mm_movemask_epi8 (_mm_cmpeq_epi32 (v, _mm_setzero_si128 ())) != 0xFFFF;
+  }
+
+  friend Sse2Vec operator& (const Sse2Vec& a, const Sse2Vec& b)
+  {
+    return make (_mm_and_si128 (a.v, b.v));
+  }
+
+  friend Sse2Vec operator| (const Sse2Vec& a, const Sse2Vec& b)
+  {
+    return make (_mm_or_si128 (a.v, b.v));
+  }
+
+  friend Sse2Vec operator>> (const Sse2Vec& a, const int n)
+  {
+    return make (_mm_srli_epi32 (a.v, n));
+  }
+
+  friend Sse2Vec operator<< (const Sse2Vec& a, const int n)
+  {
+    return make (_mm_slli_epi32 (a.v, n));
+  }
+
+  friend Sse2Vec andnot (const Sse2Vec& a, const Sse2Vec& b)
+  {
+    return make (_mm_andnot_si128 (a.v, b.v));
+  }
+};
+
+bool propagate_sse2 (BitboardSolver::State& state)
+{
+  return propagate_kernel<Sse2Vec> (state);
+}
+
+void propagate_batch_sse2 (BitboardSolver::State* states, const int count, bool* valid)
+{
+  propagate_batch_kernel<Sse2Vec> (states, count, valid);
+}
+#endif
+
+bool propagate_portable (BitboardSolver::State& state)
+{
+  return propagate_kernel<PortableVec> (state);
+}
+
+void propagate_batch_portable (BitboardSolver::State* states, const int count, bool* valid)
+{
+  propagate_batch_kernel<PortableVec> (states, count, valid);
+}
+
+BitboardSolver::Kernel select_kernel (const char*& name)
+{
+#if defined(__x86_64__)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    name = "avx2";
+    return &propagate_avx2;
+  }
+#endif
+#if defined(__SSE2__)
+  name = "sse2";
+  return &propagate_sse2;
+#else
+  name = "portable";
+  return &propagate_portable;
+#endif
+}
+
+BitboardSolver::BatchKernel select_batch_kernel (int& width)
+{
+#if defined(__x86_64__)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    width = 8;
+    return &propagate_batch_avx2;
+  }
+#endif
+#if defined(__SSE2__)
+  width = 4;
+  return &propagate_batch_sse2;
+#else
+  width = 4;
+  return &propagate_batch_portable;
+#endif
+}
@@ -14,52 +14,205 @@
 #include <algorithm>
 #include <memory>
 #include <iostream>
-#include <math.h>
 
 #include "constraint_propagation.hpp"
 
-static const int GRID_SIZE = 9;
-static const int TUPLE_SIZE = GRID_SIZE / 3;
+/// Advances idx to the next size-combination of n items in lexicographic order
+static bool next_combination (int* idx, const int size, const int n)
+{
+  int i = size - 1;
 
-Cell::Cell():
-  flags_(GRID_SIZE, true)
+  while (i >= 0 && idx[i] == n - size + i)
+  {
+    --i;
+  }
+  if (i < 0)
+  {
+    return false;
+  }
+  ++idx[i];
+  for (int j = i + 1; j < size; ++j)
+  {
+    idx[j] = idx[j - 1] + 1;
+  }
+
+  return true;
+}
+
+const char* CSPRules::name (const int rule)
+{
+  static const char* names[RULE_COUNT] = {"pointing", "box-line reduction", "naked pair",
+    "naked triple", "hidden pair", "hidden triple", "x-wing"};
+
+  return (rule >= 0 && rule < RULE_COUNT ? names[rule] : "unknown");
+}
+
+const char* CSPRules::order_name (const int order)
+{
+  static const char* names[] = {"natural", "least constraining", "peer frequency", "random"};
+
+  return (order >= NATURAL && order <= RANDOM ? names[order] : "unknown");
+}
+
+//==================================================================================================
+//==================================================================================================
+
+NogoodStore::NogoodStore ():
+  max_count_ (0),
+  max_length_ (0),
+  learned_ (0),
+  pruned_ (0)
 {}
 
-bool Cell::is_on (const int i) const
+void NogoodStore::set_limits (const int max_count, const int max_length)
+{
+  max_count_ = (max_count > 0 ? max_count : 0);
+  max_length_ = (max_length > 0 ? max_length : 0);
+  forget ();
+}
+
+bool NogoodStore::enabled () const
+{
+  return max_count_ > 0;
+}
+
+void NogoodStore::forget ()
+{
+  nogoods_.clear ();
+}
+
+void NogoodStore::clear ()
+{
+  forget ();
+  learned_ = 0;
+  pruned_ = 0;
+}
+
+void NogoodStore::learn (const std::vector <int>& path, const std::vector <char>& levels)
+{
+  std::vector <int> nogood;
+
+  for (unsigned int l = 1; l < levels.size () && l <= path.size (); ++l)
+  {
+    if (levels[l])
+    {
+      nogood.push_back (path[l - 1]);
+    }
+  }
+  /// An empty nogood only says that the puzzle has no solution
+  if (!enabled () || nogood.empty () || (int) nogood.size () > max_length_)
+  {
+    return;
+  }
+  if ((int) nogoods_.size () == max_count_)
+  {
+    nogoods_.pop_front ();
+  }
+  nogoods_.push_back (nogood);
+  ++learned_;
+}
+
+void NogoodStore::count_prune ()
+{
+  ++pruned_;
+}
+
+int NogoodStore::size () const
+{
+  return nogoods_.size ();
+}
+
+const std::vector <int>& NogoodStore::at (const int i) const
+{
+  return nogoods_[i];
+}
+
+long NogoodStore::learned () const
+{
+  return learned_;
+}
+
+long NogoodStore::pruned () const
+{
+  return pruned_;
+}
+
+//==================================================================================================
+//==================================================================================================
+
+template <int GRID_SIZE>
+Cell<GRID_SIZE>::Cell()
+{
+  flags_.set ();
+}
+
+template <int GRID_SIZE>
+bool Cell<GRID_SIZE>::is_on (const int i) const
 {
   return flags_[i-1];
 }
 
-int Cell::count () const
+template <int GRID_SIZE>
+int Cell<GRID_SIZE>::count () const
 {
-  return std::count (flags_.begin (), flags_.end (), true);
+  return flags_.count ();
 }
 
-void Cell::eliminate (const int i)
+template <int GRID_SIZE>
+void Cell<GRID_SIZE>::eliminate (const int i)
 {
   flags_[i-1] = false;
 }
 
-int Cell::get_value () const
+template <int GRID_SIZE>
+int Cell<GRID_SIZE>::get_value () const
 {
-  auto it = find (flags_.begin (), flags_.end (), true);
-  
-  return (it != flags_.end () ? 1 + (it - flags_.begin ()) : -1);
+  for (int i = 0; i < GRID_SIZE; ++i)
+  {
+    if (flags_[i])
+    {
+      return i + 1;
+    }
+  }
+
+  return -1;
+}
+
+template <int GRID_SIZE>
+const std::bitset <GRID_SIZE>& Cell<GRID_SIZE>::candidates () const
+{
+  return flags_;
 }
 
 //==================================================================================================
 //==================================================================================================
 
-std::vector <std::vector <int> > CSPSolver::group_ (GRID_SIZE * TUPLE_SIZE);
-std::vector <std::vector <int> > CSPSolver::neighbors_ (pow (GRID_SIZE, 2));
-std::vector <std::vector <int> > CSPSolver::groups_of_ (pow (GRID_SIZE, 2));
+template <int BOX_ROWS, int BOX_COLS>
+int CSPSolver<BOX_ROWS, BOX_COLS>::group_[UNIT_KINDS * GRID_SIZE][GRID_SIZE];
+template <int BOX_ROWS, int BOX_COLS>
+int CSPSolver<BOX_ROWS, BOX_COLS>::neighbors_[CELLS][PEERS];
+template <int BOX_ROWS, int BOX_COLS>
+int CSPSolver<BOX_ROWS, BOX_COLS>::groups_of_[CELLS][UNIT_KINDS];
+template <int BOX_ROWS, int BOX_COLS>
+uint64_t CSPSolver<BOX_ROWS, BOX_COLS>::zobrist_[CELLS * GRID_SIZE];
+template <int BOX_ROWS, int BOX_COLS>
+uint64_t CSPSolver<BOX_ROWS, BOX_COLS>::full_hash_ = 0;
+template <int BOX_ROWS, int BOX_COLS>
+std::once_flag CSPSolver<BOX_ROWS, BOX_COLS>::initialized_;
 
-CSPSolver::CSPSolver (const std::vector <std::vector<int> >& input_grid):
-  nodes_ (pow (GRID_SIZE, 2)),
-  valid_ (true)
+template <int BOX_ROWS, int BOX_COLS>
+CSPSolver<BOX_ROWS, BOX_COLS>::CSPSolver (const std::vector <std::vector<int> >& input_grid,
+  CSPRules* rules):
+  valid_ (true),
+  rules_ (rules),
+  hash_ (full_hash_),
+  level_ (0),
+  solved_ (0),
+  reasons_ (rules != NULL && rules->nogoods != NULL ? CELLS * GRID_SIZE : 0)
 {
   int counter = 0;
-  
+
+  conflict_ = because (Reason::RULE);
   for (unsigned int i = 0; i < input_grid.size (); ++i)
   {
     for (unsigned int j = 0; j < input_grid[i].size (); ++j)
@@ -68,8 +221,11 @@ CSPSolver::CSPSolver (const std::vector <std::vector<int> >& input_grid):
       {
         if (!assign (counter, input_grid[i][j]))
         {
-          std::cerr << "ERROR! Repeated or invalid value '" << input_grid[i][j] \
-          << "' in puzzle at row: " << i + 1 << ", column: " << j + 1 << "." << std::endl;
+          if (rules == NULL || !rules->quiet)
+          {
+            std::cerr << "ERROR! Repeated or invalid value '" << input_grid[i][j] \
+            << "' in puzzle at row: " << i + 1 << ", column: " << j + 1 << "." << std::endl;
+          }
           valid_ = false;
           return;
         }
@@ -79,115 +235,187 @@ CSPSolver::CSPSolver (const std::vector <std::vector<int> >& input_grid):
   }
 }
 
-void CSPSolver::init ()
+template <int BOX_ROWS, int BOX_COLS>
+void CSPSolver<BOX_ROWS, BOX_COLS>::init ()
+{
+  /// Units may already be set up by an earlier call
+  std::call_once (initialized_, build_tables);
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+void CSPSolver<BOX_ROWS, BOX_COLS>::build_tables ()
 {
   int k = 0;
   int val = 0;
-  
+  int filled[UNIT_KINDS * GRID_SIZE] = {0};
+  /// Fixed seed, so that hashes are the same from one run to the next
+  std::mt19937_64 rng (CELLS);
+
+  for (int i = 0; i < CELLS * GRID_SIZE; ++i)
+  {
+    zobrist_[i] = rng ();
+    full_hash_ ^= zobrist_[i];
+  }
   for (int i = 0; i < GRID_SIZE; ++i)
   {
     for (int j = 0; j < GRID_SIZE; ++j)
     {
-      const int x[TUPLE_SIZE] = {i, GRID_SIZE + j, 18 + (i/TUPLE_SIZE) * TUPLE_SIZE + j/TUPLE_SIZE};
+      /// There are BOX_ROWS boxes across the grid, each BOX_COLS cells wide
+      const int x[UNIT_KINDS] = {i, GRID_SIZE + j,
+        2 * GRID_SIZE + (i / BOX_ROWS) * BOX_ROWS + j / BOX_COLS};
 
       k = i * GRID_SIZE + j;
-      for (int g = 0; g < TUPLE_SIZE; ++g)
+      for (int g = 0; g < UNIT_KINDS; ++g)
       {
-        group_[x[g]].push_back (k);
-        groups_of_[k].push_back (x[g]);
+        group_[x[g]][filled[x[g]]++] = k;
+        groups_of_[k][g] = x[g];
       }
     }
   }
-  for (unsigned int i = 0; i < neighbors_.size (); ++i)
+  for (int i = 0; i < CELLS; ++i)
   {
-    for (unsigned int j = 0; j < groups_of_[i].size (); ++j)
+    int n = 0;
+
+    for (int j = 0; j < UNIT_KINDS; ++j)
     {
       for (int k = 0; k < GRID_SIZE; ++k)
       {
         val = group_[groups_of_[i][j]][k];
-        if (val != (int) i)
+        if (val != i)
         {
-          neighbors_[i].push_back (val);
+          neighbors_[i][n++] = val;
         }
       }
     }
   }
 }
 
-bool CSPSolver::is_valid () const
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::is_valid () const
 {
   return valid_;
 }
 
-Cell CSPSolver::possible (const int i) const
+template <int BOX_ROWS, int BOX_COLS>
+Cell <BOX_ROWS * BOX_COLS> CSPSolver<BOX_ROWS, BOX_COLS>::possible (const int i) const
 {
   return nodes_[i];
 }
 
-bool CSPSolver::is_solved () const
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::is_solved () const
 {
-  for (unsigned int i = 0; i < nodes_.size (); ++i)
+  for (int i = 0; i < CELLS; ++i)
   {
     if (nodes_[i].count () != 1)
     {
       return false;
     }
   }
-  
+
   return true;
 }
 
-bool CSPSolver::assign (const int k, const int value)
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::assign (const int k, const int value)
+{
+  return assign (k, value, because (Reason::DECISION));
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::decide (const int k, const int value)
+{
+  ++level_;
+
+  return assign (k, value, because (Reason::DECISION));
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+int CSPSolver<BOX_ROWS, BOX_COLS>::solved () const
+{
+  return solved_;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+int CSPSolver<BOX_ROWS, BOX_COLS>::level () const
+{
+  return level_;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::assign (const int k, const int value, const Reason why)
 {
   for (int i = 1; i <= GRID_SIZE; ++i)
   {
     if (i != value)
     {
-      if (!eliminate (k, i))
+      if (!eliminate (k, i, why))
       {
-        return false;  
+        return false;
       }
     }
   }
-  
+
   return true;
 }
 
-bool CSPSolver::eliminate (const int k, const int value)
+template <int BOX_ROWS, int BOX_COLS>
+typename CSPSolver<BOX_ROWS, BOX_COLS>::Reason CSPSolver<BOX_ROWS, BOX_COLS>::because (
+  const int kind, const int index, const int value) const
+{
+  Reason why;
+
+  why.kind = kind;
+  why.level = level_;
+  why.index = index;
+  why.value = value;
+
+  return why;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::eliminate (const int k, const int value, const Reason why)
 {
   if (!nodes_[k].is_on (value))
   {
     return true;
   }
   nodes_[k].eliminate (value);
+  hash_ ^= zobrist_[k * GRID_SIZE + value - 1];
+  if (!reasons_.empty ())
+  {
+    reasons_[k * GRID_SIZE + value - 1] = why;
+  }
   const int N = nodes_[k].count ();
 
   if (N == 0)
   {
+    conflict_ = because (Reason::EMPTY_CELL, k);
     return false;
   }
   else if (N == 1)
   {
     const int v = nodes_[k].get_value ();
-    
-    for (unsigned int i = 0; i < neighbors_[k].size (); ++i)
+
+    ++solved_;
+    for (int i = 0; i < PEERS; ++i)
     {
-      if (!eliminate (neighbors_[k][i], v))
+      if (!eliminate (neighbors_[k][i], v, because (Reason::NAKED, k)))
       {
         return false;
       }
     }
   }
-  for (unsigned int i = 0; i < groups_of_[k].size (); ++i)
+  for (int i = 0; i < UNIT_KINDS; ++i)
   {
     const int x = groups_of_[k][i];
     int n = 0;
     int ks = 0;
-    
+
     for (int j = 0; j < GRID_SIZE; ++j)
     {
       const int p = group_[x][j];
-      
+
       if (nodes_[p].is_on (value))
       {
         ++n;
@@ -196,40 +424,567 @@ bool CSPSolver::eliminate (const int k, const int value)
     }
     if (n == 0)
     {
+      conflict_ = because (Reason::EMPTY_UNIT, x, value);
       return false;
     }
     else if (n == 1)
     {
-      if (!assign (ks, value))
+      if (!assign (ks, value, because (Reason::HIDDEN, x, value)))
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::propagate ()
+{
+  bool changed = true;
+
+  if (rules_ == NULL || rules_->level == CSPRules::SINGLES)
+  {
+    return true;
+  }
+  /// Cheaper rules are retried first whenever a rule makes progress
+  while (changed)
+  {
+    changed = false;
+    if (!locked_candidates (changed))
+    {
+      return false;
+    }
+    if (!changed && rules_->level >= CSPRules::SUBSETS)
+    {
+      if (!naked_subsets (2, changed) || !hidden_subsets (2, changed))
+      {
+        return false;
+      }
+      if (!changed && (!naked_subsets (3, changed) || !hidden_subsets (3, changed)))
       {
         return false;
       }
     }
+    if (!changed && rules_->level >= CSPRules::FISH && !x_wing (changed))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::remove (const int k, const int value, bool& changed)
+{
+  if (!nodes_[k].is_on (value))
+  {
+    return true;
+  }
+  changed = true;
+
+  return eliminate (k, value, because (Reason::RULE));
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::locked_candidates (bool& changed)
+{
+  const int max_span = (BOX_ROWS > BOX_COLS ? BOX_ROWS : BOX_COLS);
+  int cells[GRID_SIZE];
+
+  for (int u = 0; u < UNIT_KINDS * GRID_SIZE; ++u)
+  {
+    const int kind = u / GRID_SIZE;
+
+    for (int v = 1; v <= GRID_SIZE; ++v)
+    {
+      int n = 0;
+
+      for (int j = 0; j < GRID_SIZE; ++j)
+      {
+        if (nodes_[group_[u][j]].is_on (v))
+        {
+          cells[n++] = group_[u][j];
+        }
+      }
+      if (n < 2 || n > max_span)
+      {
+        continue;
+      }
+      /// Look for another unit holding all the candidates
+      for (int g = 0; g < UNIT_KINDS; ++g)
+      {
+        const int w = groups_of_[cells[0]][g];
+        bool fired = false;
+        int i = 1;
+
+        while (i < n && groups_of_[cells[i]][g] == w)
+        {
+          ++i;
+        }
+        if (w == u || i < n)
+        {
+          continue;
+        }
+        for (int j = 0; j < GRID_SIZE; ++j)
+        {
+          const int p = group_[w][j];
+
+          if (groups_of_[p][kind] != u && !remove (p, v, fired))
+          {
+            return false;
+          }
+        }
+        if (fired)
+        {
+          ++rules_->fired[kind == 2 ? CSPRules::POINTING : CSPRules::BOX_LINE];
+          changed = true;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::naked_subsets (const int size, bool& changed)
+{
+  const int rule = (size == 2 ? CSPRules::NAKED_PAIR : CSPRules::NAKED_TRIPLE);
+  int members[GRID_SIZE];
+  int idx[GRID_SIZE];
+
+  for (int u = 0; u < UNIT_KINDS * GRID_SIZE; ++u)
+  {
+    int n = 0;
+
+    for (int j = 0; j < GRID_SIZE; ++j)
+    {
+      const int c = nodes_[group_[u][j]].count ();
+
+      if (c >= 2 && c <= size)
+      {
+        members[n++] = j;
+      }
+    }
+    if (n < size)
+    {
+      continue;
+    }
+    for (int i = 0; i < size; ++i)
+    {
+      idx[i] = i;
+    }
+    do
+    {
+      std::bitset <GRID_SIZE> values;
+      std::bitset <GRID_SIZE> subset;
+      bool fired = false;
+
+      for (int i = 0; i < size; ++i)
+      {
+        values |= nodes_[group_[u][members[idx[i]]]].candidates ();
+        subset.set (members[idx[i]]);
+      }
+      if ((int) values.count () != size)
+      {
+        continue;
+      }
+      for (int j = 0; j < GRID_SIZE; ++j)
+      {
+        for (int v = 0; v < GRID_SIZE && !subset[j]; ++v)
+        {
+          if (values[v] && !remove (group_[u][j], v + 1, fired))
+          {
+            return false;
+          }
+        }
+      }
+      if (fired)
+      {
+        ++rules_->fired[rule];
+        changed = true;
+      }
+    }
+    while (next_combination (idx, size, n));
+  }
+
+  return true;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::hidden_subsets (const int size, bool& changed)
+{
+  const int rule = (size == 2 ? CSPRules::HIDDEN_PAIR : CSPRules::HIDDEN_TRIPLE);
+  std::bitset <GRID_SIZE> where[GRID_SIZE];
+  int members[GRID_SIZE];
+  int idx[GRID_SIZE];
+
+  for (int u = 0; u < UNIT_KINDS * GRID_SIZE; ++u)
+  {
+    int n = 0;
+
+    for (int v = 0; v < GRID_SIZE; ++v)
+    {
+      where[v].reset ();
+      for (int j = 0; j < GRID_SIZE; ++j)
+      {
+        where[v][j] = nodes_[group_[u][j]].is_on (v + 1);
+      }
+      if (where[v].count () >= 2 && (int) where[v].count () <= size)
+      {
+        members[n++] = v;
+      }
+    }
+    if (n < size)
+    {
+      continue;
+    }
+    for (int i = 0; i < size; ++i)
+    {
+      idx[i] = i;
+    }
+    do
+    {
+      std::bitset <GRID_SIZE> cells;
+      std::bitset <GRID_SIZE> subset;
+      bool fired = false;
+
+      for (int i = 0; i < size; ++i)
+      {
+        cells |= where[members[idx[i]]];
+        subset.set (members[idx[i]]);
+      }
+      if ((int) cells.count () != size)
+      {
+        continue;
+      }
+      for (int j = 0; j < GRID_SIZE; ++j)
+      {
+        for (int v = 0; v < GRID_SIZE && cells[j]; ++v)
+        {
+          if (!subset[v] && !remove (group_[u][j], v + 1, fired))
+          {
+            return false;
+          }
+        }
+      }
+      if (fired)
+      {
+        ++rules_->fired[rule];
+        changed = true;
+      }
+    }
+    while (next_combination (idx, size, n));
+  }
+
+  return true;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::x_wing (bool& changed)
+{
+  std::bitset <GRID_SIZE> line[GRID_SIZE];
+
+  for (int v = 1; v <= GRID_SIZE; ++v)
+  {
+    /// Rows are units 0 to GRID_SIZE - 1, columns the next GRID_SIZE units
+    for (int kind = 0; kind < 2; ++kind)
+    {
+      for (int l = 0; l < GRID_SIZE; ++l)
+      {
+        for (int j = 0; j < GRID_SIZE; ++j)
+        {
+          line[l][j] = nodes_[group_[kind * GRID_SIZE + l][j]].is_on (v);
+        }
+      }
+      for (int l1 = 0; l1 < GRID_SIZE; ++l1)
+      {
+        for (int l2 = l1 + 1; l2 < GRID_SIZE && line[l1].count () == 2; ++l2)
+        {
+          bool fired = false;
+
+          if (line[l2] != line[l1])
+          {
+            continue;
+          }
+          for (int j = 0; j < GRID_SIZE; ++j)
+          {
+            for (int m = 0; m < GRID_SIZE && line[l1][j]; ++m)
+            {
+              const int p = group_[(1 - kind) * GRID_SIZE + j][m];
+
+              if (m != l1 && m != l2 && !remove (p, v, fired))
+              {
+                return false;
+              }
+            }
+          }
+          if (fired)
+          {
+            ++rules_->fired[CSPRules::X_WING];
+            changed = true;
+          }
+        }
+      }
+    }
   }
-  
+
   return true;
 }
 
-int CSPSolver::least_count () const
+template <int BOX_ROWS, int BOX_COLS>
+int CSPSolver<BOX_ROWS, BOX_COLS>::least_count () const
 {
+  const bool random_ties = (rules_ != NULL && rules_->random_ties);
   int k = -1;
   int min = 0;
-  
-  for (unsigned int i = 0; i < nodes_.size (); ++i)
+  int ties = 0;
+
+  for (int i = 0; i < CELLS; ++i)
   {
     const int m = nodes_[i].count ();
-    
+
     if (m > 1 && (k == -1 || m < min))
     {
       min = m;
       k = i;
+      ties = 1;
+    }
+    else if (random_ties && m == min && rules_->rng () % ++ties == 0)
+    {
+      /// Each of the tied cells ends up picked with the same probability
+      k = i;
     }
   }
-  
+
   return k;
 }
 
-void CSPSolver::output (std::vector <std::vector <int> >& output_grid) const
+template <int BOX_ROWS, int BOX_COLS>
+int CSPSolver<BOX_ROWS, BOX_COLS>::order_values (const int k, int* values) const
+{
+  const Cell <GRID_SIZE>& cell = nodes_[k];
+  const int order = (rules_ != NULL ? rules_->value_order : CSPRules::NATURAL);
+  int score[GRID_SIZE + 1];
+  int count = 0;
+
+  for (int v = 1; v <= GRID_SIZE; ++v)
+  {
+    if (cell.is_on (v))
+    {
+      values[count++] = v;
+    }
+  }
+  if (order == CSPRules::RANDOM)
+  {
+    std::shuffle (values, values + count, rules_->rng);
+  }
+  else if (order == CSPRules::LEAST_CONSTRAINING || order == CSPRules::PEER_FREQUENCY)
+  {
+    /// Score each value by the number of peers it is still a candidate of
+    for (int i = 0; i < count; ++i)
+    {
+      score[values[i]] = 0;
+    }
+    for (int n = 0; n < PEERS; ++n)
+    {
+      const Cell <GRID_SIZE>& peer = nodes_[neighbors_[k][n]];
+
+      for (int i = 0; i < count; ++i)
+      {
+        score[values[i]] += peer.is_on (values[i]);
+      }
+    }
+    /// Least constraining values rule out the fewest peer candidates, the most frequent ones the
+    /// most, failing first on a wrong guess
+    if (order == CSPRules::LEAST_CONSTRAINING)
+    {
+      std::stable_sort (values, values + count, [&score] (int a, int b)
+        { return score[a] < score[b]; });
+    }
+    else
+    {
+      std::stable_sort (values, values + count, [&score] (int a, int b)
+        { return score[a] > score[b]; });
+    }
+  }
+
+  return count;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+bool CSPSolver<BOX_ROWS, BOX_COLS>::is_known_dead () const
+{
+  return rules_ != NULL && rules_->table != NULL && rules_->table->contains (hash_);
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+void CSPSolver<BOX_ROWS, BOX_COLS>::mark_dead (const uint64_t key) const
+{
+  if (rules_ != NULL && rules_->table != NULL)
+  {
+    rules_->table->store (key);
+  }
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+uint64_t CSPSolver<BOX_ROWS, BOX_COLS>::hash () const
+{
+  return hash_;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+void CSPSolver<BOX_ROWS, BOX_COLS>::explain_conflict (std::vector <char>& levels) const
+{
+  std::vector <int> literals;
+
+  if (conflict_.kind == Reason::EMPTY_CELL)
+  {
+    for (int v = 0; v < GRID_SIZE; ++v)
+    {
+      literals.push_back (conflict_.index * GRID_SIZE + v);
+    }
+  }
+  else if (conflict_.kind == Reason::EMPTY_UNIT)
+  {
+    for (int j = 0; j < GRID_SIZE; ++j)
+    {
+      literals.push_back (group_[conflict_.index][j] * GRID_SIZE + conflict_.value - 1);
+    }
+  }
+  else
+  {
+    /// Nothing is known about the contradiction, every decision may have taken part in it
+    levels.resize (level_ + 1, 0);
+    std::fill (levels.begin () + 1, levels.end (), 1);
+  }
+  explain (literals, levels);
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+void CSPSolver<BOX_ROWS, BOX_COLS>::explain_cell (const int k, std::vector <char>& levels) const
+{
+  std::vector <int> literals;
+
+  for (int v = 1; v <= GRID_SIZE; ++v)
+  {
+    if (!nodes_[k].is_on (v))
+    {
+      literals.push_back (k * GRID_SIZE + v - 1);
+    }
+  }
+  explain (literals, levels);
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+void CSPSolver<BOX_ROWS, BOX_COLS>::explain_nogood (const std::vector <int>& nogood,
+  std::vector <char>& levels) const
+{
+  std::vector <int> literals;
+
+  /// A decision holds once every other value of its cell is gone
+  for (unsigned int i = 0; i < nogood.size (); ++i)
+  {
+    const int k = nogood[i] / GRID_SIZE;
+
+    for (int v = 0; v < GRID_SIZE; ++v)
+    {
+      if (v != nogood[i] % GRID_SIZE)
+      {
+        literals.push_back (k * GRID_SIZE + v);
+      }
+    }
+  }
+  explain (literals, levels);
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+int CSPSolver<BOX_ROWS, BOX_COLS>::violated (const NogoodStore& nogoods) const
+{
+  for (int i = 0; i < nogoods.size (); ++i)
+  {
+    const std::vector <int>& nogood = nogoods.at (i);
+    unsigned int j = 0;
+
+    while (j < nogood.size () && nodes_[nogood[j] / GRID_SIZE].count () == 1 \
+      && nodes_[nogood[j] / GRID_SIZE].is_on (nogood[j] % GRID_SIZE + 1))
+    {
+      ++j;
+    }
+    if (j == nogood.size ())
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+void CSPSolver<BOX_ROWS, BOX_COLS>::explain (std::vector <int>& literals,
+  std::vector <char>& levels) const
+{
+  std::vector <char> seen (reasons_.size (), 0);
+
+  if ((int) levels.size () < level_ + 1)
+  {
+    levels.resize (level_ + 1, 0);
+  }
+  while (!literals.empty ())
+  {
+    const int literal = literals.back ();
+
+    literals.pop_back ();
+    if (seen[literal])
+    {
+      continue;
+    }
+    seen[literal] = 1;
+    const Reason& why = reasons_[literal];
+
+    /// Eliminations before the first decision only follow from the clues
+    if (why.level == 0)
+    {
+      continue;
+    }
+    switch (why.kind)
+    {
+      case Reason::DECISION:
+        levels[why.level] = 1;
+        break;
+      case Reason::NAKED:
+        /// The solved cell lost every other value
+        for (int v = 0; v < GRID_SIZE; ++v)
+        {
+          if (v != literal % GRID_SIZE)
+          {
+            literals.push_back (why.index * GRID_SIZE + v);
+          }
+        }
+        break;
+      case Reason::HIDDEN:
+        /// The value was gone from the rest of the unit
+        for (int j = 0; j < GRID_SIZE; ++j)
+        {
+          if (group_[why.index][j] != literal / GRID_SIZE)
+          {
+            literals.push_back (group_[why.index][j] * GRID_SIZE + why.value - 1);
+          }
+        }
+        break;
+      default:
+        /// The stronger rules are not traced, every earlier decision may have taken part
+        std::fill (levels.begin () + 1, levels.begin () + why.level + 1, 1);
+        break;
+    }
+  }
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+void CSPSolver<BOX_ROWS, BOX_COLS>::output (std::vector <std::vector <int> >& output_grid) const
 {
   for (int i = 0; i < GRID_SIZE; ++i)
   {
@@ -240,32 +995,242 @@ void CSPSolver::output (std::vector <std::vector <int> >& output_grid) const
   }
 }
 
-std::unique_ptr<CSPSolver> solve_csp_aux (std::unique_ptr<CSPSolver> solver)
+template <int BOX_ROWS, int BOX_COLS>
+std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> > solve_csp_aux (
+  std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> > solver, SearchLimits* limits)
 {
+  typedef CSPSolver<BOX_ROWS, BOX_COLS> Solver;
   int k = 0;
-  Cell cell;
-  
+  int values[Solver::GRID_SIZE];
+  int count = 0;
+
   if (solver == nullptr || !solver->is_valid () || solver->is_solved ())
   {
     return solver;
   }
+  if (limits != NULL && !limits->tick ())
+  {
+    return {};
+  }
   k = solver->least_count ();
-  cell = solver->possible (k);
-  for (int i = 1; i <= GRID_SIZE; i++)
+  count = solver->order_values (k, values);
+  if (limits != NULL)
   {
-    if (cell.is_on (i))
+    limits->stats ().branch (count, solver->level () + 1);
+  }
+  for (int i = 0; i < count; i++)
+  {
+    std::unique_ptr<Solver> solver_0 (new Solver (*solver));
+    const bool alive = solver_0->decide (k, values[i]) && solver_0->propagate () && \
+    !solver_0->is_known_dead ();
+
+    if (limits != NULL)
     {
-      std::unique_ptr<CSPSolver> solver_0 (new CSPSolver (*solver));
-      
-      if (solver_0->assign (k, i))
+      limits->stats ().guess (solver_0->solved () - solver->solved () - 1);
+    }
+    if (alive)
+    {
+      const uint64_t key = solver_0->hash ();
+
+      if (auto solver_1 = solve_csp_aux (std::move (solver_0), limits))
       {
-        if (auto solver_1 = solve_csp_aux (std::move (solver_0)))
-        {
-          return solver_1;
-        }
+        return solver_1;
+      }
+      /// Only a fully explored state is known to lead nowhere
+      if (limits == NULL || !limits->expired ())
+      {
+        solver->mark_dead (key);
       }
     }
+    if (limits != NULL && limits->expired ())
+    {
+      break;
+    }
+    else if (limits != NULL)
+    {
+      ++limits->stats ().backtracks;
+    }
   }
-  
+
   return {};
 }
+
+template <int BOX_ROWS, int BOX_COLS>
+std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> > solve_csp_learning (
+  std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> > solver, NogoodStore& nogoods,
+  std::vector <int>& path, std::vector <char>& conflict, SearchLimits* limits)
+{
+  typedef CSPSolver<BOX_ROWS, BOX_COLS> Solver;
+  const int level = (solver != nullptr ? solver->level () : 0);
+  bool jumped = false;
+  int k = 0;
+  int values[Solver::GRID_SIZE];
+  int count = 0;
+
+  conflict.assign (level + 1, 0);
+  if (solver == nullptr || !solver->is_valid () || solver->is_solved ())
+  {
+    return solver;
+  }
+  if (limits != NULL && !limits->tick ())
+  {
+    return {};
+  }
+  k = solver->least_count ();
+  count = solver->order_values (k, values);
+  if (limits != NULL)
+  {
+    limits->stats ().branch (count, level + 1);
+  }
+  /// The values already ruled out of the cell take part in the failure of every branch
+  solver->explain_cell (k, conflict);
+  for (int i = 0; i < count && !jumped; i++)
+  {
+    std::unique_ptr<Solver> solver_0 (new Solver (*solver));
+    std::vector <char> reason;
+    int nogood = -1;
+    const bool alive = solver_0->decide (k, values[i]) && solver_0->propagate ();
+
+    if (limits != NULL)
+    {
+      limits->stats ().guess (solver_0->solved () - solver->solved () - 1);
+    }
+    if (!alive)
+    {
+      solver_0->explain_conflict (reason);
+    }
+    else if ((nogood = solver_0->violated (nogoods)) != -1)
+    {
+      nogoods.count_prune ();
+      solver_0->explain_nogood (nogoods.at (nogood), reason);
+    }
+    else if (solver_0->is_known_dead ())
+    {
+      reason.assign (level + 2, 1);
+    }
+    else
+    {
+      const uint64_t key = solver_0->hash ();
+
+      path.push_back (k * Solver::GRID_SIZE + values[i] - 1);
+      auto solver_1 = solve_csp_learning (std::move (solver_0), nogoods, path, reason, limits);
+      path.pop_back ();
+      if (solver_1 != nullptr)
+      {
+        return solver_1;
+      }
+      else if (limits != NULL && limits->expired ())
+      {
+        return {};
+      }
+      solver->mark_dead (key);
+    }
+    if (limits != NULL)
+    {
+      ++limits->stats ().backtracks;
+    }
+    reason.resize (level + 2, 0);
+    if (!reason[level + 1])
+    {
+      /// The decision played no part in the failure, nor would the other values of the cell
+      conflict.assign (reason.begin (), reason.begin () + level + 1);
+      jumped = true;
+    }
+    else
+    {
+      for (int l = 1; l <= level; ++l)
+      {
+        conflict[l] |= reason[l];
+      }
+    }
+  }
+  nogoods.learn (path, conflict);
+
+  return {};
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+int count_csp_solutions (const CSPSolver<BOX_ROWS, BOX_COLS>& solver, const int limit,
+  std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> >& first, SearchLimits* limits)
+{
+  typedef CSPSolver<BOX_ROWS, BOX_COLS> Solver;
+  int k = 0;
+  int count = 0;
+  int values[Solver::GRID_SIZE];
+  int value_count = 0;
+
+  if (!solver.is_valid ())
+  {
+    return 0;
+  }
+  if (solver.is_solved ())
+  {
+    if (first == nullptr)
+    {
+      first.reset (new Solver (solver));
+    }
+    return 1;
+  }
+  if (limits != NULL && !limits->tick ())
+  {
+    return 0;
+  }
+  k = solver.least_count ();
+  value_count = solver.order_values (k, values);
+  if (limits != NULL)
+  {
+    limits->stats ().branch (value_count, solver.level () + 1);
+  }
+  for (int i = 0; i < value_count && count < limit; i++)
+  {
+    /// Solvers are too large to be kept on the stack of a deep search
+    std::unique_ptr<Solver> solver_0 (new Solver (solver));
+    const bool alive = solver_0->decide (k, values[i]) && solver_0->propagate () && \
+    !solver_0->is_known_dead ();
+
+    if (limits != NULL)
+    {
+      limits->stats ().guess (solver_0->solved () - solver.solved () - 1);
+    }
+    if (alive)
+    {
+      const int found = count_csp_solutions (*solver_0, limit - count, first, limits);
+
+      /// Only a fully explored state is known to lead nowhere
+      if (found == 0 && (limits == NULL || !limits->expired ()))
+      {
+        solver.mark_dead (solver_0->hash ());
+      }
+      count += found;
+    }
+    if (limits != NULL && limits->expired ())
+    {
+      break;
+    }
+    else if (limits != NULL && count < limit)
+    {
+      ++limits->stats ().backtracks;
+    }
+  }
+
+  return count;
+}
+
+/// Supported box geometries
+#define INSTANTIATE_CSP(R, C) \
+  template class Cell<R * C>; \
+  template class CSPSolver<R, C>; \
+  template std::unique_ptr<CSPSolver<R, C> > solve_csp_aux (std::unique_ptr<CSPSolver<R, C> >, \
+    SearchLimits*); \
+  template std::unique_ptr<CSPSolver<R, C> > solve_csp_learning ( \
+    std::unique_ptr<CSPSolver<R, C> >, NogoodStore&, std::vector <int>&, std::vector <char>&, \
+    SearchLimits*); \
+  template int count_csp_solutions (const CSPSolver<R, C>&, const int, \
+    std::unique_ptr<CSPSolver<R, C> >&, SearchLimits*);
+
+INSTANTIATE_CSP (3, 3)
+INSTANTIATE_CSP (2, 5)
+INSTANTIATE_CSP (3, 4)
+INSTANTIATE_CSP (4, 4)
+INSTANTIATE_CSP (5, 5)
+INSTANTIATE_CSP (6, 6)
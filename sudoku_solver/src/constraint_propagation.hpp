@@ -9,18 +9,212 @@
  * Peter Norvig.
  *
  * Reference: http://norvig.com/sudoku.html
+ *
+ * The solver is templated on the dimensions of a box, so a puzzle is BOX_ROWS * BOX_COLS cells
+ * wide. Instantiations are provided for 9x9 (3x3 boxes), 10x10 (2x5), 12x12 (3x4), 16x16 (4x4),
+ * 25x25 (5x5) and 36x36 (6x6) puzzles.
+ *
+ * Besides naked and hidden singles, the solver can apply the stronger deductions of human solvers
+ * before each branching step, selected by a propagation level (see CSPRules). The order in which
+ * the values of the branching cell are tried is selected the same way.
+ *
+ * The candidates of a puzzle are hashed incrementally with Zobrist keys, so that the search can
+ * skip states already found to lead nowhere (see TranspositionTable).
+ *
+ * In learning mode, the solver also records why each candidate was eliminated. When a branch fails,
+ * the search traces the failure back to the decisions responsible for it. It stores these decisions
+ * as a nogood (see NogoodStore) and jumps back past the decisions that played no part in it.
  */
 
 #ifndef CONSTRAINT_PROPAGATION_HPP
 #define CONSTRAINT_PROPAGATION_HPP
 
 #include <vector>
+#include <array>
+#include <deque>
+#include <bitset>
+#include <memory>
+#include <random>
+#include <mutex>
+
+#include "search_limits.hpp"
+#include "transposition_table.hpp"
+
+class NogoodStore;
+
+struct CSPRules
+{
+  /// Propagation levels, each one includes the rules of the previous levels
+  enum Level
+  {
+    SINGLES = 0,
+    LOCKED_CANDIDATES,
+    SUBSETS,
+    FISH
+  };
+
+  /// Rules beyond naked and hidden singles
+  enum Rule
+  {
+    POINTING = 0,
+    BOX_LINE,
+    NAKED_PAIR,
+    NAKED_TRIPLE,
+    HIDDEN_PAIR,
+    HIDDEN_TRIPLE,
+    X_WING,
+    RULE_COUNT
+  };
+
+  /// Orders in which the candidate values of the branching cell are tried
+  enum ValueOrder
+  {
+    NATURAL = 0,
+    LEAST_CONSTRAINING,
+    PEER_FREQUENCY,
+    RANDOM
+  };
+
+  int level;
+  int value_order;
+  /// Break ties between branching cells at random, used when the search restarts
+  bool random_ties;
+  /// Source of the random value order and tie-breaking, seeded once per puzzle
+  std::mt19937 rng;
+  /// States known to lead nowhere, NULL if they are not recorded
+  TranspositionTable* table;
+  /// Learned nogoods, NULL unless the search runs in learning mode
+  NogoodStore* nogoods;
+  /// Number of times each rule eliminated at least one candidate
+  long fired[RULE_COUNT];
+  /// Keep invalid clues from being reported on the console
+  bool quiet;
+
+  CSPRules ():
+    level (SINGLES),
+    value_order (NATURAL),
+    random_ties (false),
+    table (NULL),
+    nogoods (NULL),
+    quiet (false)
+  {
+    clear ();
+  }
+
+  void clear ()
+  {
+    for (int i = 0; i < RULE_COUNT; ++i)
+    {
+      fired[i] = 0;
+    }
+  }
+
+  /*! \brief Returns the display name of a rule.
+   *
+   * \param rule Rule of type int.
+   *
+   * \return Rule name.
+   */
+  static const char* name (const int rule);
+
+  /*! \brief Returns the display name of a value order.
+   *
+   * \param order Value order of type int.
+   *
+   * \return Value order name.
+   */
+  static const char* order_name (const int order);
+};
+
+//==================================================================================================
+//==================================================================================================
+
+class NogoodStore
+{
+public:
+  /*! \brief Constructor of NogoodStore. NogoodStore holds sets of decisions, each one given as
+   * cell * GRID_SIZE + value - 1, that cannot all hold at once in the current puzzle. The store
+   * is disabled until it is given limits.
+   */
+  NogoodStore ();
+
+  /*! \brief Set the size limits of the store. Once full, the oldest nogood makes room for the
+   * newest one.
+   *
+   * \param max_count Maximum number of nogoods of type int. Zero or less disables the store.
+   * \param max_length Maximum number of decisions in a nogood of type int. Longer nogoods are
+   * not stored, as they seldom prune anything.
+   */
+  void set_limits (const int max_count, const int max_length);
+
+  /*! \brief Returns whether the store has been given limits.
+   *
+   * \return Status of type bool.
+   */
+  bool enabled () const;
+
+  /*! \brief Forgets every nogood. Must be called before each puzzle.
+   */
+  void forget ();
+
+  /*! \brief Forgets every nogood and resets the counters.
+   */
+  void clear ();
+
+  /*! \brief Stores the decisions of a search path found to lead nowhere together.
+   *
+   * \param path Decisions of the search path, the decision of level l at index l - 1.
+   * \param levels Flags of the levels responsible for the failure.
+   */
+  void learn (const std::vector <int>& path, const std::vector <char>& levels);
+
+  /*! \brief Accounts for a branch pruned by a nogood.
+   */
+  void count_prune ();
+
+  /*! \brief Returns the number of nogoods held.
+   *
+   * \return Nogood count of type int.
+   */
+  int size () const;
+
+  /*! \brief Returns a nogood.
+   *
+   * \param i Index of nogood of type int.
+   *
+   * \return Decisions of the nogood.
+   */
+  const std::vector <int>& at (const int i) const;
 
+  /*! \brief Returns the number of nogoods stored since the last clear.
+   *
+   * \return Nogood count of type long.
+   */
+  long learned () const;
+
+  /*! \brief Returns the number of branches pruned by a nogood since the last clear.
+   *
+   * \return Branch count of type long.
+   */
+  long pruned () const;
+
+private:
+  std::deque <std::vector <int> > nogoods_;
+  int max_count_;
+  int max_length_;
+  long learned_;
+  long pruned_;
+};
+
+//==================================================================================================
+//==================================================================================================
+
+template <int GRID_SIZE>
 class Cell
 {
 public:
-  /*! \brief Constructor of Cell. Cell represents the building block of a Sudoku puzzle. In a 9x9
-   * puzzle, cell size is 3x3
+  /*! \brief Constructor of Cell. Cell represents the building block of a Sudoku puzzle and holds
+   * one candidate flag per value of the grid.
    */
   Cell ();
 
@@ -50,23 +244,42 @@ public:
    */
   int get_value () const;
 
+  /*! \brief Returns the candidate flags of the cell, bit i - 1 standing for value i.
+   * 
+   * \return Candidate flags.
+   */
+  const std::bitset <GRID_SIZE>& candidates () const;
+
 private:
-  std::vector <bool> flags_;
+  std::bitset <GRID_SIZE> flags_;
 };
 
 //==================================================================================================
 //==================================================================================================
 
+template <int BOX_ROWS, int BOX_COLS>
 class CSPSolver
 {
 public:
+  /// Number of cells in a row, column or box
+  static const int GRID_SIZE = BOX_ROWS * BOX_COLS;
+  /// Number of cells in the puzzle
+  static const int CELLS = GRID_SIZE * GRID_SIZE;
+  /// Rows, columns and boxes
+  static const int UNIT_KINDS = 3;
+  /// Number of peers listed per cell, those sharing two units with it are listed twice
+  static const int PEERS = UNIT_KINDS * (GRID_SIZE - 1);
+
   /*! \brief Constructor of CSPSolver.
    *
    * \param input_grid Sudoku puzzle to solve of type std::vector <std::vector<int> >.
+   * \param rules Optional propagation rules, shared with every copy of the solver. Only naked
+   * and hidden singles are applied without them.
    */
-  CSPSolver (const std::vector <std::vector<int> >& input_grid);
+  CSPSolver (const std::vector <std::vector<int> >& input_grid, CSPRules* rules = NULL);
 
-  /*! \brief Initializes internal state and global variables.
+  /*! \brief Initializes internal state and global variables. Safe to call from several threads
+   * at once, only the first call does the work.
    */
   static void init ();
 
@@ -82,7 +295,7 @@ public:
    * 
    * \return Next cell of type Cell.
    */
-  Cell possible (const int i) const;
+  Cell <BOX_ROWS * BOX_COLS> possible (const int i) const;
 
   /*! \brief Returns whether the puzzle was solved or not.
    * 
@@ -100,12 +313,103 @@ public:
    */
   bool assign (const int k, const int value);
 
-  /*! \brief Returns the cell with the least number of available slots.
+  /*! \brief Assigns a value to a cell as a search decision, one level deeper than the current
+   * one.
+   *
+   * \param k Cell index of type int.
+   * \param value Value of type val.
+   * 
+   * \return Status of type bool.
+   */
+  bool decide (const int k, const int value);
+
+  /*! \brief Returns the number of cells down to a single value, given, decided or propagated.
+   *
+   * \return Cell count of type int.
+   */
+  int solved () const;
+
+  /*! \brief Returns the number of search decisions behind the current state.
+   *
+   * \return Level of type int.
+   */
+  int level () const;
+
+  /*! \brief Applies the rules of the propagation level until none of them eliminates anything.
+   * Singles are applied on every elimination regardless of the level.
+   * 
+   * \return Status of type bool. false if the puzzle turned out to be contradictory.
+   */
+  bool propagate ();
+
+  /*! \brief Returns the cell with the least number of available slots. Ties go to the first
+   * such cell, or to a random one if the rules ask for random tie-breaking.
    *
    * \return ID of cell of type int.
    */
   int least_count () const;
 
+  /*! \brief Lists the candidate values of a cell in the order they are to be tried in, as set by
+   * the value order of the rules. Without rules the values are tried in increasing order.
+   *
+   * \param k Index of cell of type int.
+   * \param values Receives the values, must hold GRID_SIZE entries.
+   *
+   * \return Number of values of type int.
+   */
+  int order_values (const int k, int* values) const;
+
+  /*! \brief Returns whether the current state of the puzzle is already known to lead nowhere.
+   * Always false without a transposition table.
+   *
+   * \return Status of type bool.
+   */
+  bool is_known_dead () const;
+
+  /*! \brief Records a state of the puzzle as leading nowhere, if there is a transposition
+   * table. The state may be gone already, so it is only given by its hash.
+   *
+   * \param key Zobrist hash of the state.
+   */
+  void mark_dead (const uint64_t key) const;
+
+  /*! \brief Returns the Zobrist hash of the candidates of the puzzle.
+   *
+   * \return Hash of type uint64_t.
+   */
+  uint64_t hash () const;
+
+  /*! \brief Flags the levels of the decisions that led to the last contradiction. Only
+   * available in learning mode.
+   *
+   * \param levels Receives the flags, indexed by level.
+   */
+  void explain_conflict (std::vector <char>& levels) const;
+
+  /*! \brief Flags the levels of the decisions that ruled out values of a cell. Only available
+   * in learning mode.
+   *
+   * \param k Index of cell of type int.
+   * \param levels Receives the flags, indexed by level.
+   */
+  void explain_cell (const int k, std::vector <char>& levels) const;
+
+  /*! \brief Flags the levels of the decisions that made the decisions of a nogood hold. Only
+   * available in learning mode.
+   *
+   * \param nogood Decisions of the nogood.
+   * \param levels Receives the flags, indexed by level.
+   */
+  void explain_nogood (const std::vector <int>& nogood, std::vector <char>& levels) const;
+
+  /*! \brief Returns the first nogood whose decisions all hold in the current state.
+   *
+   * \param nogoods Nogoods to check.
+   *
+   * \return Index of nogood or -1 if none holds.
+   */
+  int violated (const NogoodStore& nogoods) const;
+
   /*! \brief Copies the puzzle's solution to the final container.
    * 
    * \param output_grid Solved Sudoku puzzle of type std::vector <std::vector<int> >.
@@ -113,11 +417,51 @@ public:
   void output (std::vector <std::vector <int> >& output_grid) const;
 
 private:
-  std::vector <Cell> nodes_;
+  friend struct MicroBench;
+
+  /// Why a candidate was eliminated, or why the puzzle turned out to be contradictory
+  struct Reason
+  {
+    enum Kind
+    {
+      DECISION = 0,
+      NAKED,
+      HIDDEN,
+      RULE,
+      EMPTY_CELL,
+      EMPTY_UNIT
+    };
+
+    unsigned char kind;
+    /// Decision level at which it happened
+    unsigned short level;
+    /// Solved cell of a naked single, unit of a hidden single, empty cell or unit
+    unsigned short index;
+    /// Value of a hidden single or of an empty unit
+    unsigned short value;
+  };
+
+  /// Fixed-size storage, so a copy duplicates no heap memory of its own outside of learning mode.
+  /// The search still allocates every copy on the heap, one per search node.
+  std::array <Cell <GRID_SIZE>, CELLS> nodes_;
   bool valid_;
-  static std::vector <std::vector<int> > group_;
-  static std::vector <std::vector<int> > neighbors_;
-  static std::vector <std::vector<int> > groups_of_;
+  CSPRules* rules_;
+  uint64_t hash_;
+  int level_;
+  int solved_;
+  /// Reason of each eliminated candidate, empty unless in learning mode, where every copy of the
+  /// solver allocates its own
+  std::vector <Reason> reasons_;
+  Reason conflict_;
+  static int group_[UNIT_KINDS * GRID_SIZE][GRID_SIZE];
+  static int neighbors_[CELLS][PEERS];
+  static int groups_of_[CELLS][UNIT_KINDS];
+  /// One Zobrist key per candidate, GRID_SIZE per cell
+  static uint64_t zobrist_[CELLS * GRID_SIZE];
+  /// Hash of a puzzle with every candidate still on
+  static uint64_t full_hash_;
+  /// The tables are built once per geometry, even if solvers are initialized from several threads
+  static std::once_flag initialized_;
 
   /*! \brief Eliminates a value from a cell, narrowing the search space.
    *
@@ -126,15 +470,129 @@ private:
    * 
    * \return Status of type bool. Indicates if the algorithm ended up in an invalid state.
    */
-  bool eliminate (const int k, const int value);
+  bool eliminate (const int k, const int value, const Reason why);
+
+  /*! \brief Assigns a value to a cell, eliminating the others for the given reason.
+   *
+   * \param k Cell index of type int.
+   * \param value Value of type val.
+   * \param why Reason of the eliminations.
+   * 
+   * \return Status of type bool.
+   */
+  bool assign (const int k, const int value, const Reason why);
+
+  /*! \brief Returns a reason of the current level.
+   *
+   * \param kind Reason kind of type int.
+   * \param index Cell or unit of the reason of type int.
+   * \param value Value of the reason of type int.
+   *
+   * \return Reason.
+   */
+  Reason because (const int kind, const int index = 0, const int value = 0) const;
+
+  /*! \brief Flags the levels of the decisions that eliminated candidates, tracing the reasons of
+   * each elimination back to decisions.
+   *
+   * \param literals Eliminated candidates, as cell * GRID_SIZE + value - 1. Emptied on return.
+   * \param levels Receives the flags, indexed by level.
+   */
+  void explain (std::vector <int>& literals, std::vector <char>& levels) const;
+
+  /*! \brief Eliminates a value from a cell if it is still a candidate there.
+   *
+   * \param k Index of cell of type int.
+   * \param value Value to be eliminated of type int.
+   * \param changed Set to true if the value was a candidate.
+   * 
+   * \return Status of type bool. false if the algorithm ended up in an invalid state.
+   */
+  bool remove (const int k, const int value, bool& changed);
+
+  /*! \brief Pointing and box-line reduction: if the candidates of a value in a unit all lie in
+   * a second unit, the value is eliminated from the rest of the second unit.
+   *
+   * \param changed Set to true if a candidate was eliminated.
+   * 
+   * \return Status of type bool. false if the algorithm ended up in an invalid state.
+   */
+  bool locked_candidates (bool& changed);
+
+  /*! \brief Naked subsets: size cells of a unit that only hold size values between them take
+   * these values away from the rest of the unit.
+   *
+   * \param size Subset size of type int, 2 or 3.
+   * \param changed Set to true if a candidate was eliminated.
+   * 
+   * \return Status of type bool. false if the algorithm ended up in an invalid state.
+   */
+  bool naked_subsets (const int size, bool& changed);
+
+  /*! \brief Hidden subsets: size values that only fit in size cells of a unit take away every
+   * other value from these cells.
+   *
+   * \param size Subset size of type int, 2 or 3.
+   * \param changed Set to true if a candidate was eliminated.
+   * 
+   * \return Status of type bool. false if the algorithm ended up in an invalid state.
+   */
+  bool hidden_subsets (const int size, bool& changed);
+
+  /*! \brief X-wing: if a value fits in the same two columns of two rows, it is eliminated from
+   * the rest of these columns, and likewise with rows and columns swapped.
+   *
+   * \param changed Set to true if a candidate was eliminated.
+   * 
+   * \return Status of type bool. false if the algorithm ended up in an invalid state.
+   */
+  bool x_wing (bool& changed);
+
+  /*! \brief Builds the units, peers and Zobrist keys of the geometry.
+   */
+  static void build_tables ();
 };
 
 /*! \brief Auxiliary function to be called to solve a puzzle.
  *
  * \param solver pointer of type CSPSolver.
+ * \param limits Optional search budget. The search is abandoned once it expires.
  * 
  * \return pointer of type CSPSolver.
  */
-std::unique_ptr<CSPSolver> solve_csp_aux (std::unique_ptr<CSPSolver> solver);
+template <int BOX_ROWS, int BOX_COLS>
+std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> > solve_csp_aux (
+  std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> > solver, SearchLimits* limits = NULL);
+
+/*! \brief Solves a puzzle in learning mode. Failed branches are traced back to the decisions
+ * responsible, which are stored as nogoods, and the search jumps straight back to the deepest of
+ * these decisions. Branches in which a nogood holds are skipped.
+ *
+ * \param solver pointer of type CSPSolver.
+ * \param nogoods Nogood store of the puzzle.
+ * \param path Decisions leading to the solver, the decision of level l at index l - 1.
+ * \param conflict Receives the flags of the levels responsible for a failure.
+ * \param limits Optional search budget. The search is abandoned once it expires.
+ * 
+ * \return pointer of type CSPSolver.
+ */
+template <int BOX_ROWS, int BOX_COLS>
+std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> > solve_csp_learning (
+  std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> > solver, NogoodStore& nogoods,
+  std::vector <int>& path, std::vector <char>& conflict, SearchLimits* limits = NULL);
+
+/*! \brief Counts the solutions of a puzzle. The search stops as soon as limit solutions have
+ * been found, so a limit of 2 is enough to check whether a puzzle has a unique solution.
+ *
+ * \param solver Puzzle to examine of type CSPSolver.
+ * \param limit Maximum number of solutions to look for of type int.
+ * \param first Receives the first solution found, if any.
+ * \param limits Optional search budget. The search is abandoned once it expires.
+ * 
+ * \return Number of solutions found of type int.
+ */
+template <int BOX_ROWS, int BOX_COLS>
+int count_csp_solutions (const CSPSolver<BOX_ROWS, BOX_COLS>& solver, const int limit,
+  std::unique_ptr<CSPSolver<BOX_ROWS, BOX_COLS> >& first, SearchLimits* limits = NULL);
 
 #endif // CONSTRAINT_PROPAGATION_HPP
@@ -12,12 +12,31 @@
  *            http://en.wikipedia.org/wiki/Dancing_Links
  */
 
-#include <math.h>
 #include "exact_cover.hpp"
 
+/// Every candidate row covers one row, column, cell and box constraint
+static const int NODES_PER_ROW = 4;
+
+Node::Node ():
+  left_ (0),
+  right_ (0),
+  top_ (0),
+  bottom_ (0),
+  col_header_ (0)
+{}
+
+//==================================================================================================
+//==================================================================================================
+
 ExactCoverSolver::ExactCoverSolver ():
   solved_(false),
-  total_competition_ (0),
+  solution_limit_ (1),
+  solution_count_ (0),
+  timed_out_ (false),
+  quiet_ (false),
+  limits_ (NULL),
+  rng_ (NULL),
+  depth_ (0),
   GRID_SIZE_ (0),
   ROW_OFFSET_ (0),
   COL_OFFSET_ (0),
@@ -27,229 +46,204 @@ ExactCoverSolver::ExactCoverSolver ():
   MAX_ROWS_ (0),
   COL_BOX_DIV_ (0),
   ROW_BOX_DIV_ (0)
-{
-  root_ = new Node<int>;
-  root_->header_ = true;
-  root_->right_ = root_;
-  root_->left_ = root_;
-  root_->top_ = root_;
-  root_->bottom_ = root_;
-  solved_ = false;
-}
+{}
 
-ExactCoverSolver::~ExactCoverSolver ()
+bool ExactCoverSolver::box_dims (const int grid_size, int& box_rows, int& box_cols)
 {
-  cleanup ();
-  delete root_;
+  box_rows = 0;
+  box_cols = 0;
+  for (int r = 2; r * r <= grid_size; ++r)
+  {
+    if (grid_size % r == 0)
+    {
+      box_rows = r;
+      box_cols = grid_size / r;
+    }
+  }
+
+  return box_rows != 0;
 }
 
 bool ExactCoverSolver::init (const int grid_size)
 {
-  GRID_SIZE_ = grid_size;
-  ROW_OFFSET_ = 0;
-  COL_OFFSET_ = pow (grid_size, 2);
-  CELL_OFFSET_ = COL_OFFSET_ * 2;
-  BOX_OFFSET_ = COL_OFFSET_ * 3;
-  MAX_COLS_ = COL_OFFSET_ * 4;
-  MAX_ROWS_ = COL_OFFSET_ * GRID_SIZE_;
-  
-  if (grid_size == 9)
-  {
-    COL_BOX_DIV_ = 3;
-    ROW_BOX_DIV_ = 3;
-  }
-  else if (grid_size == 10)
+  int box_rows = 0;
+  int box_cols = 0;
+
+  if (!box_dims (grid_size, box_rows, box_cols))
   {
-    COL_BOX_DIV_ = 2;
-    ROW_BOX_DIV_ = 5;
+    return false;
   }
-  else if (grid_size == 12)
+
+  return init (box_rows, box_cols);
+}
+
+bool ExactCoverSolver::init (const int box_rows, const int box_cols)
+{
+  if (box_rows < 1 || box_cols < 1)
   {
-    COL_BOX_DIV_ = 4;
-    ROW_BOX_DIV_ = 3;
+    return false;
   }
-  else if (grid_size == 16)
+  else if (box_rows == ROW_BOX_DIV_ && box_cols == COL_BOX_DIV_)
   {
-    COL_BOX_DIV_ = 4;
-    ROW_BOX_DIV_ = 4;
+    return true;
   }
-  else
+  GRID_SIZE_ = box_rows * box_cols;
+  ROW_BOX_DIV_ = box_rows;
+  COL_BOX_DIV_ = box_cols;
+  ROW_OFFSET_ = 0;
+  COL_OFFSET_ = GRID_SIZE_ * GRID_SIZE_;
+  CELL_OFFSET_ = COL_OFFSET_ * 2;
+  BOX_OFFSET_ = COL_OFFSET_ * 3;
+  MAX_COLS_ = COL_OFFSET_ * 4;
+  MAX_ROWS_ = COL_OFFSET_ * GRID_SIZE_;
+
+  /// The pool holds the root, the column headers and the nodes of every candidate row, nothing
+  /// else is allocated
+  nodes_.clear ();
+  nodes_.reserve (1 + MAX_COLS_ + NODES_PER_ROW * MAX_ROWS_);
+  nodes_.resize (1 + MAX_COLS_);
+  col_size_.assign (1 + MAX_COLS_, 0);
+  /// Link column headers to the root
+  for (int j = ROOT; j <= MAX_COLS_; ++j)
   {
-    return false;
+    nodes_[j].left_ = (j == ROOT ? MAX_COLS_ : j - 1);
+    nodes_[j].right_ = (j == MAX_COLS_ ? ROOT : j + 1);
+    nodes_[j].top_ = j;
+    nodes_[j].bottom_ = j;
+    nodes_[j].col_header_ = j;
   }
-  
-  Node<int>* matrix[MAX_ROWS_][MAX_COLS_];
-  int row = 0;
-  int tmp = 0;
-  Node<int>* row_node = NULL;
-  Node<int>* col_node = NULL;
-  Node<int>* cell_node = NULL;
-  Node<int>* box_node = NULL;
-  //initialize matrix
-   for (int i = 0; i < MAX_ROWS_; ++i)
-   {
-     for (int j = 0; j < MAX_COLS_; ++j)
-     {
-       matrix[i][j] = NULL;
-     }
-   }
-    
   for (int i = 0; i < GRID_SIZE_; ++i)
   {
     for (int j = 0; j < GRID_SIZE_; ++j)
     {
+      /// There are ROW_BOX_DIV_ boxes across the grid, each COL_BOX_DIV_ cells wide
+      const int box = (i / ROW_BOX_DIV_) * ROW_BOX_DIV_ + j / COL_BOX_DIV_;
+
       for (int k = 0; k < GRID_SIZE_; ++k)
       {
-        row = (i * COL_OFFSET_ + j * GRID_SIZE_ + k);
-        row_node = new Node<int> (i, j, k);
-        matrix[row][ROW_OFFSET_ + (i * GRID_SIZE_ + k)] = row_node;
-        
-        col_node = new Node<int> (i, j, k);
-        matrix[row][COL_OFFSET_ + (j * GRID_SIZE_ + k)] = col_node;
-        
-        cell_node = new Node<int> (i, j, k);
-        matrix[row][CELL_OFFSET_ + (i * GRID_SIZE_ + j)] = cell_node;
-        
-        tmp = BOX_OFFSET_ + ((i / ROW_BOX_DIV_ + j / COL_BOX_DIV_ * COL_BOX_DIV_) * GRID_SIZE_ + k);
-        box_node = matrix[row][tmp] = new Node<int> (i, j, k);
+        /// Candidate rows are laid out in order, the first node of row
+        /// (i * COL_OFFSET_ + j * GRID_SIZE_ + k) is found by find ()
+        const int row_node = append (ROW_OFFSET_ + (i * GRID_SIZE_ + k));
+        const int col_node = append (COL_OFFSET_ + (j * GRID_SIZE_ + k));
+        const int cell_node = append (CELL_OFFSET_ + (i * GRID_SIZE_ + j));
+        const int box_node = append (BOX_OFFSET_ + (box * GRID_SIZE_ + k));
+
         /// Link nodes
-        row_node->right_ = col_node;
-        row_node->left_ = box_node;
-        
-        col_node->left_ = row_node;
-        col_node->right_ = cell_node;
-        
-        cell_node->left_ = col_node;
-        cell_node->right_ = box_node;
-        
-        box_node->left_ = cell_node;
-        box_node->right_ = row_node;
-      }
-    }
-  }
-  
-  Node<int>* next_col_header;
-  Node<int>* next_col_row;
-  /// Link columns to construct dancing links
-  for (int j = 0; j < MAX_COLS_; ++j)
-  {
-    next_col_header = new Node<int>;
-    next_col_header->header_ = true;
-    next_col_header->top_ = next_col_header;
-    next_col_header->bottom_ = next_col_header;
-    next_col_header->left_ = next_col_header;
-    next_col_header->right_ = next_col_header;
-    next_col_header->col_header_ = next_col_header;
-    next_col_row = next_col_header;
-    for (int i = 0; i < MAX_ROWS_; ++i)
-    {
-      if (matrix[i][j] != NULL)
-      {
-        //search down rows to add to column
-        matrix[i][j]->top_ = next_col_row;
-        next_col_row->bottom_ = matrix[i][j];
-        matrix[i][j]->bottom_ = next_col_header;
-        next_col_header->top_ = matrix[i][j];
-        matrix[i][j]->col_header_ = next_col_header;
-        next_col_row = matrix[i][j];
-      }
-    }
-    if (next_col_header->bottom_ == next_col_header)
-    {
-      return false;
-    }
-    
-    if (!create_col (next_col_header))
-    {
-      /// Cleanup
-      for (int i = 0; i < MAX_ROWS_; ++i)
-      {
-        for (int j = 0; j < MAX_COLS_; ++j)
-        {
-          if (matrix[i][j] != NULL)
-          {
-            delete matrix[i][j];  
-          }
-        }
+        nodes_[row_node].right_ = col_node;
+        nodes_[row_node].left_ = box_node;
+
+        nodes_[col_node].left_ = row_node;
+        nodes_[col_node].right_ = cell_node;
+
+        nodes_[cell_node].left_ = col_node;
+        nodes_[cell_node].right_ = box_node;
+
+        nodes_[box_node].left_ = cell_node;
+        nodes_[box_node].right_ = row_node;
       }
-      return false;
     }
   }
+
   return true;
 }
 
-void ExactCoverSolver::solve (const std::vector <std::vector <int> >& input_grid)
+void ExactCoverSolver::solve (const std::vector <std::vector <int> >& input_grid,
+  SearchLimits* limits)
 {
-  Node <int>* to_find = NULL;
-  Node <int>* insert_next = NULL;
-  std::stack <Node <int>*> puzzle_nodes;
-  Node <int>* col_node;
-  Node <int>* next_row_in_col;
-  Node <int>* row_node;
+  std::stack <int> puzzle_nodes;
+  bool loaded = true;
+  int insert_next = 0;
+  int row_node = 0;
   int val = 0;
-  
+
   solved_ = false;
-  total_competition_ = 0;
-//  running_sol_.clear ();
+  solution_count_ = 0;
+  timed_out_ = false;
+  limits_ = limits;
+  stats_.clear ();
+  depth_ = 0;
   while (!running_sol_.empty ())
   {
     running_sol_.pop();
   }
+  while (!solution_.empty ())
+  {
+    solution_.pop();
+  }
 
-  for (int i = 0; i < GRID_SIZE_; ++i)
+  for (int i = 0; i < GRID_SIZE_ && loaded; ++i)
   {
-    for (int j = 0; j < GRID_SIZE_; ++j)
+    for (int j = 0; j < GRID_SIZE_ && loaded; ++j)
     {
       val = input_grid[i][j];
       if (val > GRID_SIZE_ || val < 0)
       {
-        std::cout << "ERROR! Invalid puzzle specified." << std::endl;
-        return;
+        if (!quiet_)
+        {
+          std::cout << "ERROR! Invalid puzzle specified." << std::endl;
+        }
+        loaded = false;
       }
-      
-      if (val != 0)
+      else if (val != 0)
       {
-        to_find = new Node<int> (i, j, val - 1);
-        insert_next = find (to_find);
-        if (insert_next == NULL)
+        insert_next = find (i, j, val - 1);
+        if (insert_next == -1)
         {
-          std::cerr << "ERROR! Repeated or invalid value '" << val \
-          << "' in puzzle at row: " << i + 1 << ", column: " << j + 1 << "." << std::endl;
-          return;
+          if (!quiet_)
+          {
+            std::cerr << "ERROR! Repeated or invalid value '" << val \
+            << "' in puzzle at row: " << i + 1 << ", column: " << j + 1 << "." << std::endl;
+          }
+          loaded = false;
+          continue;
         }
-        col_node = insert_next->col_header_;
-        next_row_in_col = insert_next;
-        cover (col_node);
-        row_node = next_row_in_col->right_;
-        while (row_node != next_row_in_col)
+        cover (nodes_[insert_next].col_header_);
+        for (row_node = nodes_[insert_next].right_; row_node != insert_next;
+          row_node = nodes_[row_node].right_)
         {
-          cover (row_node->col_header_);
-          row_node = row_node->right_;
+          cover (nodes_[row_node].col_header_);
         }
         puzzle_nodes.push (insert_next);
         running_sol_.push (insert_next);
-        delete to_find;
-        to_find = NULL;
       }
     }
   }
+  if (limits_ != NULL)
+  {
+    limits_->lap (PhaseTimes::SETUP);
+  }
+  if (loaded)
+  {
+    solve ();
+    solved_ = (solution_count_ > 0);
+    /// A run cut off by the restart schedule is resumed by the caller, so it reports nothing
+    const bool report = !quiet_ && !(limits_ != NULL && limits_->cut_off ());
 
-  if (!solve ())
+    if (timed_out_ && report)
+    {
+      std::cout << "Puzzle search exceeded its time or node limit." << std::endl;
+    }
+    else if (!solved_ && report)
+    {
+      std::cout << "Puzzle is not solvable." << std::endl;
+    }
+  }
+  if (limits_ != NULL)
   {
-    std::cout << "Puzzle is not solvable or multiple solutions exists." << std::endl; 
+    limits_->stats ().add (stats_);
   }
-  /// Restore initial state to prepare for next puzzle
+  limits_ = NULL;
+  /// Restore initial state to prepare for next puzzle, also after an invalid clue
   while (!puzzle_nodes.empty())
   {
-    col_node = (puzzle_nodes.top ())->col_header_;
-    next_row_in_col = (puzzle_nodes.top ());
-    row_node = next_row_in_col->right_;
-    while (row_node != next_row_in_col)
+    const int next_row_in_col = puzzle_nodes.top ();
+
+    for (row_node = nodes_[next_row_in_col].left_; row_node != next_row_in_col;
+      row_node = nodes_[row_node].left_)
     {
-      uncover (row_node->col_header_);
-      row_node = row_node->right_;
+      uncover (nodes_[row_node].col_header_);
     }
-    uncover (col_node);
+    uncover (nodes_[next_row_in_col].col_header_);
     puzzle_nodes.pop();
   }
 }
@@ -259,216 +253,268 @@ bool ExactCoverSolver::is_solved () const
   return solved_;
 }
 
+void ExactCoverSolver::set_solution_limit (const int limit)
+{
+  solution_limit_ = (limit > 0 ? limit : 1);
+}
+
+int ExactCoverSolver::solution_count () const
+{
+  return solution_count_;
+}
+
+bool ExactCoverSolver::is_timed_out () const
+{
+  return timed_out_;
+}
+
+void ExactCoverSolver::set_random (std::mt19937* rng)
+{
+  rng_ = rng;
+}
+
+void ExactCoverSolver::set_quiet (const bool flag)
+{
+  quiet_ = flag;
+}
+
 void ExactCoverSolver::output (std::vector <std::vector <int> >& output_grid)
 {
-  Node<int>* next = NULL;
-  
-  if (!running_sol_.empty ())
+  while (!solution_.empty ())
   {
-    while (!running_sol_.empty ())
-    {
-      next = running_sol_.top ();
-      output_grid[next->row_][next->col_] = next->value_ + 1;
-      running_sol_.pop ();
-    }
+    const int row = (solution_.top () - 1 - MAX_COLS_) / NODES_PER_ROW;
+
+    output_grid[row / COL_OFFSET_][(row / GRID_SIZE_) % GRID_SIZE_] = row % GRID_SIZE_ + 1;
+    solution_.pop ();
   }
 }
 
 bool ExactCoverSolver::solve ()
 {
   int cols_count;
-  Node<int>* next_col = NULL;
-  Node<int>* next_row_in_col = NULL;
-  Node<int>* row_node = NULL;
+  int forced = 0;
+  bool done = false;
+  int next_col = 0;
+  int next_row_in_col = 0;
+  int row_node = 0;
 
+  /// Forced moves are committed without branching, a dead end shows up as an empty column
+  const bool alive = force (forced);
+
+  stats_.propagations += forced;
+  if (depth_ == 0 && limits_ != NULL)
+  {
+    limits_->lap (PhaseTimes::PROPAGATE);
+  }
+  if (!alive)
+  {
+    unforce (forced);
+    return false;
+  }
   if (empty ())
   {
-    return true;
+    if (solution_count_ == 0)
+    {
+      solution_ = running_sol_;
+    }
+    ++solution_count_;
+    unforce (forced);
+    return solution_count_ >= solution_limit_;
   }
-  next_col = pick_next_col (cols_count);
-  if (cols_count < 1)
+  if (limits_ != NULL && !limits_->tick ())
   {
+    timed_out_ = true;
+    unforce (forced);
     return false;
   }
-  total_competition_ += cols_count;
-  next_row_in_col = next_col->bottom_;
+  next_col = pick_next_col (cols_count);
+  stats_.branch (cols_count, depth_ + 1);
+  next_row_in_col = nodes_[next_col].bottom_;
   cover (next_col);
-  while (next_row_in_col != next_col && !solved_)
+  while (next_row_in_col != next_col && !done && !timed_out_)
   {
     running_sol_.push (next_row_in_col);
-    row_node = next_row_in_col->right_;
-    while (row_node != next_row_in_col)
+    for (row_node = nodes_[next_row_in_col].right_; row_node != next_row_in_col;
+      row_node = nodes_[row_node].right_)
     {
-      cover (row_node->col_header_);
-      row_node = row_node->right_;
+      cover (nodes_[row_node].col_header_);
     }
-    solved_= solve ();
-    if (!solved_)
+    ++stats_.guesses;
+    ++depth_;
+    done = solve ();
+    --depth_;
+    stats_.backtracks += !done;
+    running_sol_.pop ();
+    for (row_node = nodes_[next_row_in_col].left_; row_node != next_row_in_col;
+      row_node = nodes_[row_node].left_)
     {
-      running_sol_.pop ();
+      uncover (nodes_[row_node].col_header_);
     }
-    row_node = next_row_in_col->right_;
-    while (row_node != next_row_in_col)
-    {
-      uncover (row_node->col_header_);
-      row_node = row_node->right_;
-    }
-    next_row_in_col = next_row_in_col->bottom_;
+    next_row_in_col = nodes_[next_row_in_col].bottom_;
   }
   uncover (next_col);
+  unforce (forced);
 
-  return solved_;
+  return done;
 }
 
-bool ExactCoverSolver::create_col (Node<int>* new_node)
+bool ExactCoverSolver::force (int& forced)
 {
-  if (!new_node || !new_node->header_)
+  bool committed = true;
+
+  /// A commit may shrink columns the pass already went by, so passes repeat until one commits
+  /// nothing
+  while (committed)
   {
-    return false;
+    committed = false;
+    for (int col = nodes_[ROOT].right_; col != ROOT; )
+    {
+      if (col_size_[col] == 0)
+      {
+        return false;
+      }
+      else if (col_size_[col] == 1)
+      {
+        const int row = nodes_[col].bottom_;
+
+        cover (col);
+        for (int row_node = nodes_[row].right_; row_node != row;
+          row_node = nodes_[row_node].right_)
+        {
+          cover (nodes_[row_node].col_header_);
+        }
+        running_sol_.push (row);
+        ++forced;
+        committed = true;
+      }
+      /// A covered column still links to the right neighbour it had when covered, which leads to
+      /// the next column still in the list
+      col = nodes_[col].right_;
+      while (col != ROOT && nodes_[nodes_[col].left_].right_ != col)
+      {
+        col = nodes_[col].right_;
+      }
+    }
   }
 
-  return create_col_helper (new_node, root_);
+  return true;
 }
 
-bool ExactCoverSolver::create_col_helper (Node<int>* new_node, Node<int>* curr_root)
+void ExactCoverSolver::unforce (int forced)
 {
-  if (curr_root->right_ == root_ && curr_root != new_node)
-  {
-    curr_root->right_->left_ = new_node;
-    new_node->right_ = curr_root->right_;
-    new_node->left_ = curr_root;
-    curr_root->right_ = new_node;
-    
-    return true;
-  }
-  else if (curr_root == new_node)
+  for (; forced > 0; --forced)
   {
-    return false;  
-  }
-  else
-  {
-    return create_col_helper (new_node, curr_root->right_);
+    const int row = running_sol_.top ();
+
+    for (int row_node = nodes_[row].left_; row_node != row; row_node = nodes_[row_node].left_)
+    {
+      uncover (nodes_[row_node].col_header_);
+    }
+    uncover (nodes_[row].col_header_);
+    running_sol_.pop ();
   }
 }
 
-bool ExactCoverSolver::empty ()
+int ExactCoverSolver::append (const int col)
+{
+  const int header = 1 + col;
+  const int index = nodes_.size ();
+  Node node;
+
+  node.col_header_ = header;
+  node.top_ = nodes_[header].top_;
+  node.bottom_ = header;
+  nodes_.push_back (node);
+  nodes_[nodes_[header].top_].bottom_ = index;
+  nodes_[header].top_ = index;
+  ++col_size_[header];
+
+  return index;
+}
+
+bool ExactCoverSolver::empty () const
 {
-//  assert (root_ != NULL);
-  return (root_->right_ == root_);
+  return (nodes_[ROOT].right_ == ROOT);
 }
 
-void ExactCoverSolver::cover (Node<int>* node)
+void ExactCoverSolver::cover (const int col)
 {
-  Node<int>* row_node = NULL;
-  Node<int>* right_node = NULL;
-  Node<int>* col_node = node->col_header_;
-  
-  col_node->right_->left_ = col_node->left_;
-  col_node->left_->right_ = col_node->right_;
-  for (row_node = col_node->bottom_; row_node != col_node; row_node = row_node->bottom_)
+  ++stats_.covers;
+  nodes_[nodes_[col].right_].left_ = nodes_[col].left_;
+  nodes_[nodes_[col].left_].right_ = nodes_[col].right_;
+  for (int row_node = nodes_[col].bottom_; row_node != col; row_node = nodes_[row_node].bottom_)
   {
-    for (right_node = row_node->right_; right_node != row_node; right_node = right_node->right_)
+    for (int right_node = nodes_[row_node].right_; right_node != row_node;
+      right_node = nodes_[right_node].right_)
     {
-      right_node->top_->bottom_ = right_node->bottom_;
-      right_node->bottom_->top_ = right_node->top_;
+      const Node& node = nodes_[right_node];
+
+      nodes_[node.top_].bottom_ = node.bottom_;
+      nodes_[node.bottom_].top_ = node.top_;
+      --col_size_[node.col_header_];
     }
   }
 }
 
-void ExactCoverSolver::uncover (Node<int>* node)
+void ExactCoverSolver::uncover (const int col)
 {
-  Node<int>* row_node = NULL;
-  Node<int>* left_node = NULL;
-  Node<int>* col_node = node->col_header_;
-  
-  for (row_node = col_node->top_; row_node != col_node; row_node = row_node->top_)
+  for (int row_node = nodes_[col].top_; row_node != col; row_node = nodes_[row_node].top_)
   {
-    for (left_node = row_node->left_; left_node != row_node; left_node = left_node->left_)
+    for (int left_node = nodes_[row_node].left_; left_node != row_node;
+      left_node = nodes_[left_node].left_)
     {
-      left_node->top_->bottom_ = left_node;
-      left_node->bottom_->top_ = left_node;
+      const Node& node = nodes_[left_node];
+
+      nodes_[node.top_].bottom_ = left_node;
+      nodes_[node.bottom_].top_ = left_node;
+      ++col_size_[node.col_header_];
     }
   }
-  col_node->right_->left_ = col_node;
-  col_node->left_->right_ = col_node;
+  nodes_[nodes_[col].right_].left_ = col;
+  nodes_[nodes_[col].left_].right_ = col;
 }
 
-Node<int>* ExactCoverSolver::find (Node<int>* node)
+int ExactCoverSolver::find (const int r, const int c, const int v) const
 {
-  Node<int>* right_node = root_->right_;
-  Node<int>* bottom_node = NULL;
-  
-  while (right_node != root_)
+  const int first = 1 + MAX_COLS_ + NODES_PER_ROW * (r * COL_OFFSET_ + c * GRID_SIZE_ + v);
+  int node = first;
+
+  /// A candidate is gone once any of its columns has been covered
+  do
   {
-    bottom_node = right_node->bottom_;
-    while (bottom_node != right_node)
+    const int col = nodes_[node].col_header_;
+
+    if (nodes_[nodes_[col].left_].right_ != col)
     {
-      if (bottom_node->row_ == node->row_ && bottom_node->col_ == node->col_
-        && bottom_node->value_ == node->value_)
-      {
-        return bottom_node;
-      }
-      bottom_node = bottom_node->bottom_;
+      return -1;
     }
-    right_node = right_node->right_;
+    node = nodes_[node].right_;
   }
-  
-  return NULL;
+  while (node != first);
+
+  return first;
 }
 
-Node<int>* ExactCoverSolver::pick_next_col (int& count)
+int ExactCoverSolver::pick_next_col (int& count) const
 {
-  Node<int>* curr_best = root_->right_;
-  Node<int>* next = curr_best->bottom_;
-  Node<int>* next_col = curr_best;
+  int curr_best = nodes_[ROOT].right_;
   int best = -1;
-  int tmp_count = 0;
+  int ties = 0;
 
-  while (next_col != root_)
+  for (int next_col = nodes_[ROOT].right_; next_col != ROOT; next_col = nodes_[next_col].right_)
   {
-    next = next_col->bottom_;
-    tmp_count = 0;
-    while (next != next_col)
+    if (col_size_[next_col] < best || best == -1)
     {
-//      if (next == next->bottom_)
-//      {
-//        std::cout<<"Err!" << std::endl;
-//      }
-      ++tmp_count;
-      next = next->bottom_;
+      curr_best = next_col;
+      best = col_size_[next_col];
+      ties = 1;
     }
-    if (tmp_count < best || best == -1)
+    else if (rng_ != NULL && col_size_[next_col] == best && (*rng_) () % ++ties == 0)
     {
       curr_best = next_col;
-      best = tmp_count;
     }
-    next_col = next_col->right_;
   }
-//  if (curr_best == root_)
-//  {
-//    exit (0);
-//  }
   count = best;
 
   return curr_best;
 }
-
-void ExactCoverSolver::cleanup ()
-{
-  Node<int>* col_del = root_->right_;
-  Node<int>* row_del;
-  Node<int>* tmp;
-  while (col_del != root_)
-  {
-    row_del = col_del->bottom_;
-    while (!row_del->header_)
-    {
-      tmp = row_del->bottom_;
-      delete row_del;
-      row_del = tmp;
-    }
-    tmp = col_del->right_;
-    delete col_del;
-    col_del = tmp;
-  }
-}
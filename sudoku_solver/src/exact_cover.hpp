@@ -18,64 +18,32 @@
 #include <vector>
 #include <stack>
 #include <iostream>
+#include <random>
+
+#include "search_limits.hpp"
 
 class ExactCoverSolver;
 
-template <typename T>
 class Node
 {
 public:
   /*! \brief Constructor of Node. Node is the building block for dancing links, a modified
-   * doubly linked-list that can have horizontal and vertical neighbors.
+   * doubly linked-list that can have horizontal and vertical neighbors. Neighbors are referred to
+   * by their index in the solver's node pool rather than by pointer, which more than halves the
+   * size of a node.
    */
   Node ();
 
-  /*! \brief Constructor of Node.
-   *
-   * \param r Row index of type int.
-   * \param c Column index of type int.
-   * \param r Node value.
-   */
-  Node (const int r, const int c, const T v);
-
 private:
   friend class ExactCoverSolver;
-  T value_;
-  int row_;
-  int col_;
-  bool header_;
-  Node<T>* left_;
-  Node<T>* right_;
-  Node<T>* top_;
-  Node<T>* bottom_;
-  Node<T>* col_header_;
+  friend struct CrossCheck;
+  int left_;
+  int right_;
+  int top_;
+  int bottom_;
+  int col_header_;
 };
 
-template <typename T>
-Node<T>::Node ():
-  row_ (-1),
-  col_ (-1),
-  header_ (false),
-  left_ (NULL),
-  right_ (NULL),
-  top_ (NULL),
-  bottom_ (NULL),
-  col_header_ (NULL)
-{}
-
-template <typename T>
-Node<T>::Node (const int r, const int c, const T v):
-  value_ (v),
-  row_ (r),
-  col_ (c),
-  header_ (false),
-  left_ (NULL),
-  right_ (NULL),
-  top_ (NULL),
-  bottom_ (NULL),
-  col_header_ (NULL)
-{}
-
 //==================================================================================================
 //==================================================================================================
 
@@ -83,40 +51,108 @@ class ExactCoverSolver
 {
 public:
   ExactCoverSolver ();
-  
-  ~ExactCoverSolver ();
-  
-  /*! \brief Initializes solver with grid size.
+
+  /*! \brief Returns the default box geometry of a grid size: the most square one, with boxes at
+   * least as wide as they are tall (e.g. 3x3 for 9, 3x4 for 12, 2x5 for 10).
    *
    * \param grid_size Grid size of type int.
-   * 
+   * \param box_rows Receives the height of a box.
+   * \param box_cols Receives the width of a box.
+   *
+   * \return false if the grid size cannot be split into boxes of at least 2x2 cells.
+   */
+  static bool box_dims (const int grid_size, int& box_rows, int& box_cols);
+
+  /*! \brief Initializes solver with grid size, using its default box geometry.
+   *
+   * \param grid_size Grid size of type int.
+   *
    * \return Outcome of the process of type bool.
    */
   bool init (const int grid_size);
 
+  /*! \brief Initializes solver with a box geometry. The grid is box_rows * box_cols cells wide.
+   * Initializing again with the same geometry keeps the existing structure.
+   *
+   * \param box_rows Height of a box of type int.
+   * \param box_cols Width of a box of type int.
+   *
+   * \return Outcome of the process of type bool.
+   */
+  bool init (const int box_rows, const int box_cols);
+
   /*! \brief Solves a sudoku puzzle.
-   * 
+   *
    * \param input_grid Sudoku puzzle to solve of type std::vector <std::vector<int> >.
+   * \param limits Optional search budget. The search is abandoned once it expires.
    */
-  void solve (const std::vector <std::vector <int> >& input_grid);
+  void solve (const std::vector <std::vector <int> >& input_grid, SearchLimits* limits = NULL);
 
   /*! \brief Returns the status of the current puzzle.
-   * 
+   *
    * \return Returns true if puzzle was successfully solved, false otherwise.
    */
   bool is_solved () const;
 
+  /*! \brief Sets the number of solutions to look for before the search stops. The default of 1
+   * stops at the first solution; 2 is enough to check whether a puzzle has a unique solution.
+   *
+   * \param limit Solution limit of type int.
+   */
+  void set_solution_limit (const int limit);
+
+  /*! \brief Returns the number of solutions found for the current puzzle, up to the limit.
+   *
+   * \return Solution count of type int.
+   */
+  int solution_count () const;
+
+  /*! \brief Returns whether the search of the current puzzle was abandoned due to its limits.
+   *
+   * \return Returns true if the search budget expired, false otherwise.
+   */
+  bool is_timed_out () const;
+
+  /*! \brief Set a source of random numbers to break ties between branching columns with. By
+   * default ties go to the first column.
+   *
+   * \param rng Random number generator. NULL restores the default.
+   */
+  void set_random (std::mt19937* rng);
+
+  /*! \brief Keeps the solver from reporting invalid and unsolvable puzzles on the console.
+   *
+   * \param flag Toggle flag.
+   */
+  void set_quiet (const bool flag);
+
   /*! \brief Copies the puzzle's solution to the final container.
-   * 
+   *
    * \param output_grid Solved Sudoku puzzle of type std::vector <std::vector<int> >.
    */
   void output (std::vector <std::vector <int> >& output_grid);
 
 private:
-  Node <int>* root_;
-  std::stack<Node <int>* > running_sol_;
+  friend struct MicroBench;
+  friend struct CrossCheck;
+
+  /// Index of the root node in the pool, the column headers follow it
+  static const int ROOT = 0;
+  std::vector <Node> nodes_;
+  std::vector <int> col_size_;
+  std::stack <int> running_sol_;
+  std::stack <int> solution_;
   bool solved_;
-  int total_competition_;
+  int solution_limit_;
+  int solution_count_;
+  bool timed_out_;
+  bool quiet_;
+  SearchLimits* limits_;
+  std::mt19937* rng_;
+  /// Effort of the current run, added to the statistics of limits_ once it is over
+  SearchStats stats_;
+  /// Number of guesses on the current path
+  int depth_;
   int GRID_SIZE_;
   int ROW_OFFSET_;
   int COL_OFFSET_;
@@ -126,63 +162,67 @@ private:
   int MAX_ROWS_;
   int COL_BOX_DIV_;
   int ROW_BOX_DIV_;
-  
-  /*! \brief Solves a given puzzle.
-   * 
-   * \return Outcome of the process of type bool.
+
+  /*! \brief Solves a given puzzle. The first solution found is kept in solution_.
+   *
+   * \return true if the solution limit has been reached and the search must stop.
    */
   bool solve ();
 
-  /*! \brief Creates a column in the DLX structure.
+  /*! \brief Commits the only row of every column of size 1, until none is left, also columns that
+   * shrink to size 1 after the scan went by them. Committed rows are pushed on running_sol_.
    *
-   * \param new_node New node to be added.
-   * 
-   * \return Outcome of the process of type bool.
+   * \param forced Incremented for every committed row.
+   *
+   * \return false if a column ran out of rows, true otherwise.
    */
-  bool create_col (Node<int>* new_node);
+  bool force (int& forced);
 
-  /*! \brief Helper function for creating a new column.
-   * 
-   * \param new_node New node to be added.
-   * \param new_node New node's parent in the hierarchy.
+  /*! \brief Undoes the last forced moves, in reverse order.
    *
-   * \return Outcome of the process of type bool.
+   * \param forced Number of forced moves to undo.
    */
-  bool create_col_helper (Node<int>* new_node, Node<int>* r);
-  
-  bool empty ();
+  void unforce (int forced);
 
-  /*! \brief Removes a certain node from the search space.
-   * 
-   * \param node Designated node to be removed.
+  /*! \brief Appends a node to the bottom of a column.
+   *
+   * \param col Column index of type int.
+   *
+   * \return Index of the new node.
    */
-  void cover (Node<int>* node);
+  int append (const int col);
 
-  /*! \brief Restores a certain node into the search space.
-   * 
-   * \param node Designated node to be restored.
+  bool empty () const;
+
+  /*! \brief Removes a column and the rows that intersect it from the search space.
+   *
+   * \param col Index of the column header node.
    */
-  void uncover (Node<int>* node);
+  void cover (const int col);
 
-  /*! \brief Find a certain node given its parent in the hierarchy.
-   * 
-   * \param node Parent node.
+  /*! \brief Restores a column and the rows that intersect it into the search space.
    *
-   * \return Pointer to found node or NULL otherwise.
+   * \param col Index of the column header node.
    */
-  Node<int>* find (Node<int>* node);
+  void uncover (const int col);
 
-  /*! \brief Pick next column for search. Store its score.
-   * 
-   * \param count Reference to resulting node score.
+  /*! \brief Returns the first node of a candidate row.
    *
-   * \return Pointer to found node or NULL otherwise.
+   * \param r Row index of type int.
+   * \param c Column index of type int.
+   * \param v Value index (0-based) of type int.
+   *
+   * \return Node index or -1 if the candidate has been covered.
    */
-  Node<int>* pick_next_col (int& count);
+  int find (const int r, const int c, const int v) const;
 
-  /*! \brief Memory management function for releasing resources.
+  /*! \brief Pick next column for search, the one with the fewest rows. Store its score.
+   *
+   * \param count Reference to resulting node score.
+   *
+   * \return Index of found column header.
    */
-  void cleanup ();
+  int pick_next_col (int& count) const;
 };
 
 #endif /// EXACT_COVER_HPP
@@ -7,6 +7,7 @@
  */
 
 #include <string.h>
+#include <stdio.h>
 
 #include "sudoku_solver.hpp"
 
@@ -14,13 +15,54 @@ void display_usage ()
 {
   std::cout << "SudokuSolver" << std::endl;
   std::cout << "Usage" << std::endl;
-  std::cout << "  SudokuSolver [options] -f <input-file-name>" << std::endl << std::endl;
+  std::cout << "  SudokuSolver [options] -f <input-file-name>" << std::endl;
+  std::cout << "  SudokuSolver [options] -G <count>" << std::endl << std::endl;
   std::cout << "Options" << std::endl;
   std::cout << "  -o <output-file-name>     = Solved puzzle(s) output file." << std::endl;
-  std::cout << "  -t [1|2]                  = Technique used to solve puzzles." << std::endl;
+  std::cout << "  -t [1|2|3|4]              = Technique used to solve puzzles." << std::endl;
+  std::cout << "  -l [0|1|2|3]              = Propagation level of technique 1 (default: 0)." \
+  << std::endl;
+  std::cout << "  -v [0|1|2|3]              = Value order of technique 1 (default: 0)." \
+  << std::endl;
+  std::cout << "  -s <seed>                 = Seed of randomized search (default: 1)." << std::endl;
+  std::cout << "  -r [0|1|2]                = Restart schedule of techniques 1 and 2 (default: 0)." \
+  << std::endl;
+  std::cout << "  -R <count>                = Search node budget of the first run (default: 100)." \
+  << std::endl;
+  std::cout << "  -M <megabytes>            = Transposition table size of technique 1 (default: 0)." \
+  << std::endl;
+  std::cout << "  -n <count>                = Nogood store size of technique 1 (default: 0)." \
+  << std::endl;
+  std::cout << "  -L <length>               = Maximum length of a nogood (default: 16)." \
+  << std::endl;
   std::cout << "  -p                        = Enable recording of processing time." << std::endl;
+  std::cout << "  -S                        = Enable recording of search statistics." << std::endl;
+  std::cout << "  -P                        = Enable hardware performance counters (Linux)." \
+  << std::endl;
+  std::cout << "  -A                        = Enable recording of allocations and peak memory." \
+  << std::endl;
+  std::cout << "  -J <report-file-name>     = Write the run summary as JSON." << std::endl;
+  std::cout << "  --trace <trace-file-name> = Write a timeline of the run as a Chrome trace." \
+  << std::endl;
   std::cout << "  -d                        = Enable display of solved puzzle(s) on terminal." \
   << std::endl;
+  std::cout << "  -g <rows>x<cols>          = Box geometry (default: detected from input)." \
+  << std::endl;
+  std::cout << "  -T <milliseconds>         = Time limit per puzzle (0 = unlimited)." << std::endl;
+  std::cout << "  -N <count>                = Search node limit per puzzle (0 = unlimited)." \
+  << std::endl;
+  std::cout << "  -b                        = Propagate several puzzles at once (technique 4)." \
+  << std::endl;
+  std::cout << "  -u                        = Check whether each puzzle has a unique solution." \
+  << std::endl;
+  std::cout << "  -c <limit>                = Count solutions of each puzzle up to limit." \
+  << std::endl;
+  std::cout << "  -G <count>                = Generate puzzles with a unique solution." \
+  << std::endl;
+  std::cout << "  -k <clues>                = Target clue count of generated puzzles (default: 0)." \
+  << std::endl;
+  std::cout << "  -j <threads>              = Generator threads (default: 0 = every core)." \
+  << std::endl;
 }
 
 int main (int argc, char** argv)
@@ -28,8 +70,25 @@ int main (int argc, char** argv)
   SudokuSolver solver;
   std::string infile;
   std::string outfile;
+  std::string tracefile;
   int i = 1;
   int technique = -1;
+  int level = -1;
+  int value_order = -1;
+  long seed = -1;
+  int restarts = -1;
+  long restart_base = 100;
+  double table_size = 0.0;
+  int nogood_count = 0;
+  int nogood_length = 16;
+  double time_limit = 0.0;
+  long node_limit = 0;
+  int solution_limit = 1;
+  int box_rows = 0;
+  int box_cols = 0;
+  long generate_count = 0;
+  int clues = 0;
+  int threads = 0;
   
   if (argc <= 2 || (argc == 2 && (strcmp (argv[1], "-h") == 0 || strcmp (argv[1], "--help") == 0)))
   {
@@ -44,6 +103,41 @@ int main (int argc, char** argv)
       {
         solver.toggle_print_time (true);
       }
+      else if ((strcmp (argv[i], "-S") == 0 || strcmp (argv[i], "--stats") == 0))
+      {
+        solver.toggle_print_stats (true);
+      }
+      else if ((strcmp (argv[i], "-A") == 0 || strcmp (argv[i], "--allocations") == 0))
+      {
+        solver.toggle_alloc_stats (true);
+      }
+      else if ((strcmp (argv[i], "-P") == 0 || strcmp (argv[i], "--perf") == 0))
+      {
+        solver.toggle_perf_counters (true);
+      }
+      else if ((strcmp (argv[i], "-J") == 0 || strcmp (argv[i], "--report") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing report filename" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        solver.set_report_file (argv [i + 1]);
+        ++i;
+      }
+      else if (strcmp (argv[i], "--trace") == 0)
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing trace filename" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        tracefile = argv [i + 1];
+        Trace::enable ();
+        ++i;
+      }
       else if ((strcmp (argv[i], "-d") == 0 || strcmp (argv[i], "--display") == 0))
       {
         solver.toggle_terminal_output (true);
@@ -81,6 +175,178 @@ int main (int argc, char** argv)
         technique = atoi (argv [i + 1]);
         ++i;
       }
+      else if ((strcmp (argv[i], "-g") == 0 || strcmp (argv[i], "--geometry") == 0))
+      {
+        if (i + 1 == argc || sscanf (argv [i + 1], "%dx%d", &box_rows, &box_cols) != 2)
+        {
+          std::cout << "Missing or malformed box geometry" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-l") == 0 || strcmp (argv[i], "--level") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing propagation level" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        level = atoi (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-v") == 0 || strcmp (argv[i], "--value-order") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing value order" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        value_order = atoi (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-s") == 0 || strcmp (argv[i], "--seed") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing seed" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        seed = atol (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-r") == 0 || strcmp (argv[i], "--restarts") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing restart schedule" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        restarts = atoi (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-R") == 0 || strcmp (argv[i], "--restart-base") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing restart node budget" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        restart_base = atol (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-M") == 0 || strcmp (argv[i], "--table-size") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing transposition table size" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        table_size = atof (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-n") == 0 || strcmp (argv[i], "--nogoods") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing nogood store size" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        nogood_count = atoi (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-L") == 0 || strcmp (argv[i], "--nogood-length") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing nogood length" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        nogood_length = atoi (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-T") == 0 || strcmp (argv[i], "--time-limit") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing time limit" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        time_limit = atof (argv [i + 1]) / 1000.0;
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-N") == 0 || strcmp (argv[i], "--node-limit") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing node limit" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        node_limit = atol (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-b") == 0 || strcmp (argv[i], "--batch") == 0))
+      {
+        solver.toggle_batch (true);
+      }
+      else if ((strcmp (argv[i], "-u") == 0 || strcmp (argv[i], "--unique") == 0))
+      {
+        solution_limit = 2;
+      }
+      else if ((strcmp (argv[i], "-c") == 0 || strcmp (argv[i], "--count") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing solution limit" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        solution_limit = atoi (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-G") == 0 || strcmp (argv[i], "--generate") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing puzzle count" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        generate_count = atol (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-k") == 0 || strcmp (argv[i], "--clues") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing clue count" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        clues = atoi (argv [i + 1]);
+        ++i;
+      }
+      else if ((strcmp (argv[i], "-j") == 0 || strcmp (argv[i], "--threads") == 0))
+      {
+        if (i + 1 == argc)
+        {
+          std::cout << "Missing thread count" << std::endl;
+          display_usage ();
+          return 0;
+        }
+        threads = atoi (argv [i + 1]);
+        ++i;
+      }
       else
       {
         display_usage ();
@@ -90,7 +356,7 @@ int main (int argc, char** argv)
     }
   }
 
-  if (infile.empty ())
+  if (infile.empty () && generate_count == 0)
   {
     display_usage ();
     return 0;
@@ -100,13 +366,63 @@ int main (int argc, char** argv)
   {
     solver.set_technique (technique);
   }
-  if (!outfile.empty ())
+  if (level != -1)
+  {
+    solver.set_propagation_level (level);
+  }
+  if (value_order != -1)
+  {
+    solver.set_value_order (value_order);
+  }
+  if (seed >= 0)
+  {
+    solver.set_seed (seed);
+  }
+  if (restarts != -1)
+  {
+    solver.set_restarts (restarts, restart_base);
+  }
+  if (table_size > 0.0)
+  {
+    solver.set_table_size ((long) (table_size * 1024 * 1024));
+  }
+  if (nogood_count > 0)
   {
-    solver.solve (infile, outfile);
+    solver.set_nogood_limits (nogood_count, nogood_length);
+  }
+  if (box_rows != 0)
+  {
+    solver.set_box_geometry (box_rows, box_cols);
+  }
+  if (generate_count != 0)
+  {
+    solver.set_threads (threads);
+    if (!outfile.empty ())
+    {
+      solver.generate (generate_count, clues, outfile);
+    }
+    else
+    {
+      solver.generate (generate_count, clues);
+    }
   }
   else
   {
-    solver.solve (infile);
+    solver.set_time_limit (time_limit);
+    solver.set_node_limit (node_limit);
+    solver.set_solution_limit (solution_limit);
+    if (!outfile.empty ())
+    {
+      solver.solve (infile, outfile);
+    }
+    else
+    {
+      solver.solve (infile);
+    }
+  }
+  if (!tracefile.empty () && !Trace::write (tracefile))
+  {
+    std::cerr << "ERROR! Could not write trace file." << std::endl;
   }
   return 0;
 }
@@ -0,0 +1,122 @@
+/*
+ * File:   perf_counters.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perf_counters.hpp"
+
+PerfCounters::PerfCounters ():
+  opened_ (0)
+{
+  for (int e = 0; e < CounterValues::EVENT_COUNT; ++e)
+  {
+    fds_[e] = -1;
+    slots_[e] = -1;
+  }
+}
+
+PerfCounters::~PerfCounters ()
+{
+  close ();
+}
+
+bool PerfCounters::open ()
+{
+#ifdef __linux__
+  static const uint64_t configs[CounterValues::EVENT_COUNT] = {PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  int leader = -1;
+
+  close ();
+  for (int e = 0; e < CounterValues::EVENT_COUNT; ++e)
+  {
+    struct perf_event_attr attr;
+
+    memset (&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[e];
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled = (leader == -1);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    /// The first event that opens leads the group, the others start and stop along with it
+    fds_[e] = syscall (__NR_perf_event_open, &attr, 0, -1, leader, 0);
+    if (fds_[e] != -1)
+    {
+      leader = (leader == -1 ? fds_[e] : leader);
+      slots_[e] = opened_++;
+    }
+  }
+  if (leader == -1)
+  {
+    return false;
+  }
+  ioctl (leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl (leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void PerfCounters::close ()
+{
+#ifdef __linux__
+  for (int e = 0; e < CounterValues::EVENT_COUNT; ++e)
+  {
+    if (fds_[e] != -1)
+    {
+      ::close (fds_[e]);
+    }
+    fds_[e] = -1;
+    slots_[e] = -1;
+  }
+#endif
+  opened_ = 0;
+}
+
+bool PerfCounters::is_open () const
+{
+  return opened_ > 0;
+}
+
+void PerfCounters::read (CounterValues& counts) const
+{
+  counts.clear ();
+#ifdef __linux__
+  /// A read of the group gives the number of events followed by their counts
+  uint64_t data[1 + CounterValues::EVENT_COUNT];
+  int leader = -1;
+
+  for (int e = 0; e < CounterValues::EVENT_COUNT && leader == -1; ++e)
+  {
+    leader = fds_[e];
+  }
+  if (leader == -1 || ::read (leader, data, sizeof (data)) < (ssize_t) sizeof (uint64_t))
+  {
+    return;
+  }
+  for (int e = 0; e < CounterValues::EVENT_COUNT; ++e)
+  {
+    if (slots_[e] != -1 && (uint64_t) slots_[e] < data[0])
+    {
+      counts.values[e] = (long) data[1 + slots_[e]];
+    }
+  }
+#endif
+}
@@ -0,0 +1,112 @@
+/*
+ * File:   perf_counters.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Hardware performance counters of the calling thread, read through Linux perf_event_open. The
+ * counters only count user space, which an unprivileged process may do with the default
+ * perf_event_paranoid setting. They are unavailable on other systems, in most containers and on
+ * virtual machines that do not expose the PMU, in which case opening them fails and the solver
+ * carries on without them.
+ */
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+/// Counts of the hardware events over some span of time
+struct CounterValues
+{
+  enum Event
+  {
+    CYCLES = 0,
+    INSTRUCTIONS,
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    EVENT_COUNT
+  };
+
+  long values[EVENT_COUNT];
+
+  CounterValues ()
+  {
+    clear ();
+  }
+
+  void clear ()
+  {
+    for (int e = 0; e < EVENT_COUNT; ++e)
+    {
+      values[e] = 0;
+    }
+  }
+
+  void add (const CounterValues& other)
+  {
+    for (int e = 0; e < EVENT_COUNT; ++e)
+    {
+      values[e] += other.values[e];
+    }
+  }
+
+  /// Instructions per cycle
+  double ipc () const
+  {
+    return (values[CYCLES] > 0 ? (double) values[INSTRUCTIONS] / values[CYCLES] : 0.0);
+  }
+
+  static const char* name (const int event)
+  {
+    static const char* names[EVENT_COUNT] = {"cycles", "instructions", "cache misses",
+      "branch misses"};
+
+    return names[event];
+  }
+};
+
+//==================================================================================================
+//==================================================================================================
+
+class PerfCounters
+{
+public:
+  PerfCounters ();
+
+  ~PerfCounters ();
+
+  /*! \brief Opens the counters of the calling thread, which is the only one they count. Events
+   * the processor does not support read as zero.
+   *
+   * \return false if no counter could be opened, true otherwise.
+   */
+  bool open ();
+
+  /*! \brief Closes the counters.
+   */
+  void close ();
+
+  /*! \brief Returns whether the counters are open.
+   *
+   * \return Status of type bool.
+   */
+  bool is_open () const;
+
+  /*! \brief Reads the counts since the counters were opened, all events at once.
+   *
+   * \param counts Receives the counts of type CounterValues.
+   */
+  void read (CounterValues& counts) const;
+
+private:
+  /// Group leader first, -1 for events that could not be opened
+  int fds_[CounterValues::EVENT_COUNT];
+  /// Position of each event in a read of the group, -1 for events that could not be opened
+  int slots_[CounterValues::EVENT_COUNT];
+  int opened_;
+
+  PerfCounters (const PerfCounters&);
+  PerfCounters& operator= (const PerfCounters&);
+};
+
+#endif /// PERF_COUNTERS_HPP
@@ -0,0 +1,197 @@
+/*
+ * File:   puzzle_generator.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ */
+
+#include <algorithm>
+
+#include "puzzle_generator.hpp"
+
+/// Search nodes per cell of the grid that a filling or a uniqueness check may visit by default
+const static long NODES_PER_CELL = 4;
+/// Number of random solutions tried before a puzzle is given up, a filling may run out of nodes
+const static int FILL_ATTEMPTS = 8;
+
+PuzzleGenerator::PuzzleGenerator ():
+  rng_ (1),
+  box_rows_ (0),
+  box_cols_ (0),
+  grid_size_ (0)
+{}
+
+bool PuzzleGenerator::init (const int box_rows, const int box_cols)
+{
+  if (!solver_.init (box_rows, box_cols))
+  {
+    return false;
+  }
+  box_rows_ = box_rows;
+  box_cols_ = box_cols;
+  grid_size_ = box_rows * box_cols;
+  limits_.set_node_limit (NODES_PER_CELL * grid_size_ * grid_size_);
+  /// Searches cut off by the node limit are expected, they are not worth a message
+  solver_.set_quiet (true);
+
+  return true;
+}
+
+void PuzzleGenerator::seed (const unsigned int seed)
+{
+  rng_.seed (seed);
+}
+
+void PuzzleGenerator::seed (const unsigned int seed, const long stream)
+{
+  /// std::seed_seq is fully specified by the standard, unlike the distributions
+  std::seed_seq sequence {seed, (unsigned int) stream, (unsigned int) (stream >> 32)};
+
+  rng_.seed (sequence);
+}
+
+void PuzzleGenerator::set_node_limit (const long nodes)
+{
+  limits_.set_node_limit (nodes);
+}
+
+bool PuzzleGenerator::fill (std::vector <std::vector <int> >& grid)
+{
+  /// Boxes on the diagonal share no row or column, so any filling of them is consistent
+  const int diagonal = std::min (box_rows_, box_cols_);
+
+  grid.assign (grid_size_, std::vector <int> (grid_size_, 0));
+  for (int b = 0; b < diagonal; ++b)
+  {
+    const std::vector <int> values = permutation (grid_size_);
+
+    for (int k = 0; k < grid_size_; ++k)
+    {
+      grid[b * box_rows_ + k / box_cols_][b * box_cols_ + k % box_cols_] = values[k] + 1;
+    }
+  }
+  solver_.set_solution_limit (1);
+  solver_.set_random (&rng_);
+  limits_.start ();
+  solver_.solve (grid, &limits_);
+  solver_.set_random (NULL);
+  if (!solver_.is_solved () || solver_.is_timed_out ())
+  {
+    return false;
+  }
+  solver_.output (grid);
+
+  return true;
+}
+
+int PuzzleGenerator::generate (const int clues, std::vector <std::vector <int> >& puzzle)
+{
+  const int cells = grid_size_ * grid_size_;
+  int count = cells;
+  bool filled = false;
+
+  for (int attempt = 0; attempt < FILL_ATTEMPTS && grid_size_ != 0 && !filled; ++attempt)
+  {
+    filled = fill (puzzle);
+  }
+  if (!filled)
+  {
+    return 0;
+  }
+  /// Every clue is tried once, a clue that cannot go now cannot go once others are gone either
+  const std::vector <int> order = permutation (cells);
+
+  for (int k = 0; k < cells && count > clues; ++k)
+  {
+    int& cell = puzzle[order[k] / grid_size_][order[k] % grid_size_];
+    const int value = cell;
+
+    cell = 0;
+    if (is_unique (puzzle))
+    {
+      --count;
+    }
+    else
+    {
+      cell = value;
+    }
+  }
+
+  return count;
+}
+
+bool PuzzleGenerator::is_unique (const std::vector <std::vector <int> >& puzzle)
+{
+  solver_.set_solution_limit (2);
+  limits_.start ();
+  solver_.solve (puzzle, &limits_);
+
+  return !solver_.is_timed_out () && solver_.solution_count () == 1;
+}
+
+void PuzzleGenerator::shuffle (std::vector <std::vector <int> >& grid)
+{
+  const std::vector <int> values = permutation (grid_size_);
+  const std::vector <int> bands = permutation (box_cols_);
+  const std::vector <int> stacks = permutation (box_rows_);
+  std::vector <int> rows (grid_size_);
+  std::vector <int> cols (grid_size_);
+  std::vector <std::vector <int> > source (grid);
+
+  /// Row i of the result is row rows[i] of the source, likewise for columns
+  for (int b = 0; b < box_cols_; ++b)
+  {
+    const std::vector <int> within = permutation (box_rows_);
+
+    for (int r = 0; r < box_rows_; ++r)
+    {
+      rows[b * box_rows_ + r] = bands[b] * box_rows_ + within[r];
+    }
+  }
+  for (int s = 0; s < box_rows_; ++s)
+  {
+    const std::vector <int> within = permutation (box_cols_);
+
+    for (int c = 0; c < box_cols_; ++c)
+    {
+      cols[s * box_cols_ + c] = stacks[s] * box_cols_ + within[c];
+    }
+  }
+  if (box_rows_ == box_cols_ && rng_ () % 2 == 1)
+  {
+    for (int i = 0; i < grid_size_; ++i)
+    {
+      for (int j = 0; j < grid_size_; ++j)
+      {
+        source[i][j] = grid[j][i];
+      }
+    }
+  }
+  for (int i = 0; i < grid_size_; ++i)
+  {
+    for (int j = 0; j < grid_size_; ++j)
+    {
+      const int value = source[rows[i]][cols[j]];
+
+      grid[i][j] = (value == 0 ? 0 : values[value - 1] + 1);
+    }
+  }
+}
+
+std::vector <int> PuzzleGenerator::permutation (const int n)
+{
+  std::vector <int> result (n);
+
+  for (int i = 0; i < n; ++i)
+  {
+    result[i] = i;
+  }
+  /// Fisher-Yates on the raw generator output, std::shuffle differs between standard libraries
+  for (int i = n - 1; i > 0; --i)
+  {
+    std::swap (result[i], result[rng_ () % (i + 1)]);
+  }
+
+  return result;
+}
@@ -0,0 +1,111 @@
+/*
+ * File:   puzzle_generator.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Seeded generator of puzzles with a unique solution. A random solution is completed by Algorithm X
+ * from randomly filled diagonal boxes, then clues are taken away in random order as long as the
+ * puzzle keeps a unique solution. Each search is bounded by a node limit: a filling that runs out
+ * of nodes is given up, and a clue whose removal cannot be proven safe in time is kept, so that
+ * large grids are generated in bounded time. Random numbers are drawn straight from std::mt19937, so a seed
+ * gives the same puzzles on every platform.
+ */
+
+#ifndef PUZZLE_GENERATOR_HPP
+#define PUZZLE_GENERATOR_HPP
+
+#include <vector>
+#include <random>
+
+#include "exact_cover.hpp"
+
+class PuzzleGenerator
+{
+public:
+  PuzzleGenerator ();
+
+  /*! \brief Initializes generator with a box geometry. The grid is box_rows * box_cols cells wide.
+   *
+   * \param box_rows Height of a box of type int.
+   * \param box_cols Width of a box of type int.
+   *
+   * \return Outcome of the process of type bool.
+   */
+  bool init (const int box_rows, const int box_cols);
+
+  /*! \brief Restarts the sequence of random numbers.
+   *
+   * \param seed Seed of type unsigned int.
+   */
+  void seed (const unsigned int seed);
+
+  /*! \brief Restarts the sequence of random numbers of one of several independent streams, so
+   * that e.g. each puzzle of a parallel run gets the same numbers whatever thread generates it.
+   *
+   * \param seed Seed of type unsigned int.
+   * \param stream Stream index of type long.
+   */
+  void seed (const unsigned int seed, const long stream);
+
+  /*! \brief Set the maximum number of search nodes of a filling or a uniqueness check. The
+   * default scales with the number of cells of the grid.
+   *
+   * \param nodes Node limit of type long. Zero or less disables the limit.
+   */
+  void set_node_limit (const long nodes);
+
+  /*! \brief Fills a grid with a random solution.
+   *
+   * \param grid Receives the solution of type std::vector <std::vector<int> >.
+   *
+   * \return false if no solution could be completed within the node limit, true otherwise.
+   */
+  bool fill (std::vector <std::vector <int> >& grid);
+
+  /*! \brief Generates a puzzle with a unique solution. Clues are taken away until only the
+   * target count is left or none can be taken away without losing uniqueness.
+   *
+   * \param clues Target number of clues. Zero keeps taking clues away as long as possible.
+   * \param puzzle Receives the puzzle of type std::vector <std::vector<int> >.
+   *
+   * \return Number of clues of the puzzle, zero if it could not be generated.
+   */
+  int generate (const int clues, std::vector <std::vector <int> >& puzzle);
+
+  /*! \brief Returns whether a puzzle has exactly one solution. A check that runs out of nodes
+   * counts as a puzzle that may have several.
+   *
+   * \param puzzle Puzzle of type std::vector <std::vector<int> >.
+   *
+   * \return Status of type bool.
+   */
+  bool is_unique (const std::vector <std::vector <int> >& puzzle);
+
+  /*! \brief Applies a random transformation that preserves validity and difficulty: relabels the
+   * values, reorders the rows of each band, the bands, the columns of each stack and the stacks, and
+   * transposes grids of square boxes.
+   *
+   * \param grid Puzzle or solution of type std::vector <std::vector<int> >.
+   */
+  void shuffle (std::vector <std::vector <int> >& grid);
+
+private:
+  ExactCoverSolver solver_;
+  SearchLimits limits_;
+  std::mt19937 rng_;
+  int box_rows_;
+  int box_cols_;
+  int grid_size_;
+
+  /*! \brief Returns a random permutation of 0 .. n - 1.
+   *
+   * \param n Number of elements of type int.
+   *
+   * \return Permutation of type std::vector <int>.
+   */
+  std::vector <int> permutation (const int n);
+};
+
+#endif /// PUZZLE_GENERATOR_HPP
@@ -0,0 +1,321 @@
+/*
+ * File:   run_report.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+#include "run_report.hpp"
+
+LatencyHistogram::LatencyHistogram ():
+  counts_ (BUCKET_COUNT, 0)
+{
+  clear ();
+}
+
+void LatencyHistogram::clear ()
+{
+  std::fill (counts_.begin (), counts_.end (), 0);
+  count_ = 0;
+  min_ = std::numeric_limits<long>::max ();
+  max_ = 0;
+  sum_ = 0.0;
+}
+
+void LatencyHistogram::record (const double seconds)
+{
+  const long nanos = std::min ((long) llround (std::max (seconds, 0.0) * 1e9), \
+  (1L << MAX_BITS) - 1);
+
+  ++counts_[bucket (nanos)];
+  ++count_;
+  min_ = std::min (min_, nanos);
+  max_ = std::max (max_, nanos);
+  sum_ += nanos;
+}
+
+void LatencyHistogram::merge (const LatencyHistogram& other)
+{
+  for (int b = 0; b < BUCKET_COUNT; ++b)
+  {
+    counts_[b] += other.counts_[b];
+  }
+  count_ += other.count_;
+  min_ = std::min (min_, other.min_);
+  max_ = std::max (max_, other.max_);
+  sum_ += other.sum_;
+}
+
+long LatencyHistogram::count () const
+{
+  return count_;
+}
+
+long LatencyHistogram::min () const
+{
+  return (count_ > 0 ? min_ : 0);
+}
+
+long LatencyHistogram::max () const
+{
+  return max_;
+}
+
+double LatencyHistogram::mean () const
+{
+  return (count_ > 0 ? sum_ / count_ : 0.0);
+}
+
+long LatencyHistogram::percentile (const double fraction) const
+{
+  const long rank = std::max (1L, (long) ceil (fraction * count_));
+  long seen = 0;
+
+  if (count_ == 0)
+  {
+    return 0;
+  }
+  for (int b = 0; b < BUCKET_COUNT; ++b)
+  {
+    seen += counts_[b];
+    if (seen >= rank)
+    {
+      return std::max (min_, std::min (bucket_upper (b), max_));
+    }
+  }
+
+  return max_;
+}
+
+long LatencyHistogram::bucket_count (const int bucket) const
+{
+  return counts_[bucket];
+}
+
+long LatencyHistogram::bucket_lower (const int bucket)
+{
+  /// The first SUB_COUNT buckets hold one value each, the others SUB_COUNT / 2 per power of two
+  if (bucket < SUB_COUNT)
+  {
+    return bucket;
+  }
+  const int shift = bucket / (SUB_COUNT / 2) - 1;
+
+  return (bucket % (SUB_COUNT / 2) + SUB_COUNT / 2) << shift;
+}
+
+long LatencyHistogram::bucket_upper (const int bucket)
+{
+  if (bucket < SUB_COUNT)
+  {
+    return bucket;
+  }
+
+  return bucket_lower (bucket) + (1L << (bucket / (SUB_COUNT / 2) - 1)) - 1;
+}
+
+int LatencyHistogram::bucket (const long nanos)
+{
+  if (nanos < SUB_COUNT)
+  {
+    return (int) nanos;
+  }
+  /// Keep the SUB_BITS leading bits, the top one tells the power of two apart
+  const int shift = 63 - __builtin_clzl (nanos) - (SUB_BITS - 1);
+
+  return (int) (shift * (SUB_COUNT / 2) + (nanos >> shift));
+}
+
+//==================================================================================================
+//==================================================================================================
+
+RunReport::RunReport ()
+{
+  clear ();
+}
+
+void RunReport::clear ()
+{
+  latency_.clear ();
+  for (int t = 0; t < TECHNIQUE_COUNT; ++t)
+  {
+    technique_latency_[t].clear ();
+    for (int o = 0; o < OUTCOME_COUNT; ++o)
+    {
+      technique_outcomes_[t][o] = 0;
+    }
+  }
+  for (int o = 0; o < OUTCOME_COUNT; ++o)
+  {
+    outcomes_[o] = 0;
+  }
+  solving_time_ = 0.0;
+  wall_time_ = 0.0;
+}
+
+void RunReport::record (const int technique, const int outcome, const double seconds)
+{
+  const int t = (technique > 0 && technique < TECHNIQUE_COUNT ? technique : 0);
+
+  latency_.record (seconds);
+  technique_latency_[t].record (seconds);
+  ++outcomes_[outcome];
+  ++technique_outcomes_[t][outcome];
+  solving_time_ += seconds;
+}
+
+void RunReport::merge (const RunReport& other)
+{
+  latency_.merge (other.latency_);
+  for (int t = 0; t < TECHNIQUE_COUNT; ++t)
+  {
+    technique_latency_[t].merge (other.technique_latency_[t]);
+    for (int o = 0; o < OUTCOME_COUNT; ++o)
+    {
+      technique_outcomes_[t][o] += other.technique_outcomes_[t][o];
+    }
+  }
+  for (int o = 0; o < OUTCOME_COUNT; ++o)
+  {
+    outcomes_[o] += other.outcomes_[o];
+  }
+  solving_time_ += other.solving_time_;
+  /// Workers run side by side, the run lasts as long as the slowest of them
+  wall_time_ = std::max (wall_time_, other.wall_time_);
+}
+
+void RunReport::set_wall_time (const double seconds)
+{
+  wall_time_ = seconds;
+}
+
+void RunReport::print (std::ostream& out) const
+{
+  const long puzzles = latency_.count ();
+  char line[256];
+
+  out << "Run summary:\n";
+  snprintf (line, sizeof (line), "  Puzzles: %ld, solved %ld, wall time %.6f s, %.1f puzzles/s " \
+    "(%.1f puzzles/s solving)\n", puzzles, outcomes_[SOLVED], wall_time_, \
+    (wall_time_ > 0.0 ? puzzles / wall_time_ : 0.0), \
+    (solving_time_ > 0.0 ? puzzles / solving_time_ : 0.0));
+  out << line;
+  out << "  Failures:";
+  for (int o = SOLVED + 1; o < OUTCOME_COUNT; ++o)
+  {
+    out << (o == SOLVED + 1 ? " " : ", ") << outcome_name (o) << " " << outcomes_[o];
+  }
+  out << "\n";
+  snprintf (line, sizeof (line), "  Latency (us): min %.1f, mean %.1f, median %.1f, p90 %.1f, " \
+    "p99 %.1f, p99.9 %.1f, max %.1f\n", latency_.min () / 1e3, latency_.mean () / 1e3, \
+    latency_.percentile (0.5) / 1e3, latency_.percentile (0.9) / 1e3, \
+    latency_.percentile (0.99) / 1e3, latency_.percentile (0.999) / 1e3, latency_.max () / 1e3);
+  out << line;
+  out << "  By technique:\n";
+  for (int t = 0; t < TECHNIQUE_COUNT; ++t)
+  {
+    const LatencyHistogram& latency = technique_latency_[t];
+
+    if (latency.count () == 0)
+    {
+      continue;
+    }
+    snprintf (line, sizeof (line), "    %s: %ld puzzle(s), %ld solved, median %.1f us, " \
+      "p99 %.1f us, max %.1f us\n", technique_name (t), latency.count (), \
+      technique_outcomes_[t][SOLVED], latency.percentile (0.5) / 1e3, \
+      latency.percentile (0.99) / 1e3, latency.max () / 1e3);
+    out << line;
+  }
+  out.flush ();
+}
+
+/*! \brief Writes the percentiles and the non-empty buckets of a histogram as JSON members.
+ *
+ * \param out Output file.
+ * \param latency Histogram.
+ * \param indent Indentation of the members.
+ */
+static void write_latency (FILE* out, const LatencyHistogram& latency, const char* indent)
+{
+  bool first = true;
+
+  fprintf (out, "%s\"latency_us\": {\"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, " \
+    "\"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f},\n", indent, \
+    latency.min () / 1e3, latency.mean () / 1e3, latency.percentile (0.5) / 1e3, \
+    latency.percentile (0.9) / 1e3, latency.percentile (0.99) / 1e3, \
+    latency.percentile (0.999) / 1e3, latency.max () / 1e3);
+  fprintf (out, "%s\"buckets_ns\": [", indent);
+  for (int b = 0; b < LatencyHistogram::BUCKET_COUNT; ++b)
+  {
+    if (latency.bucket_count (b) > 0)
+    {
+      fprintf (out, "%s[%ld, %ld, %ld]", (first ? "" : ", "), LatencyHistogram::bucket_lower (b), \
+        LatencyHistogram::bucket_upper (b), latency.bucket_count (b));
+      first = false;
+    }
+  }
+  fprintf (out, "]");
+}
+
+bool RunReport::write_json (const std::string& path) const
+{
+  FILE* out = fopen (path.c_str (), "w");
+  bool first = true;
+
+  if (out == NULL)
+  {
+    return false;
+  }
+  fprintf (out, "{\n  \"puzzles\": %ld,\n  \"wall_seconds\": %.9f,\n  \"solving_seconds\": %.9f," \
+    "\n  \"puzzles_per_sec\": %.3f,\n  \"outcomes\": {", latency_.count (), wall_time_, \
+    solving_time_, (wall_time_ > 0.0 ? latency_.count () / wall_time_ : 0.0));
+  for (int o = 0; o < OUTCOME_COUNT; ++o)
+  {
+    fprintf (out, "%s\"%s\": %ld", (o == 0 ? "" : ", "), outcome_name (o), outcomes_[o]);
+  }
+  fprintf (out, "},\n");
+  write_latency (out, latency_, "  ");
+  fprintf (out, ",\n  \"techniques\": [");
+  for (int t = 0; t < TECHNIQUE_COUNT; ++t)
+  {
+    if (technique_latency_[t].count () == 0)
+    {
+      continue;
+    }
+    fprintf (out, "%s\n    {\n      \"technique\": \"%s\",\n      \"puzzles\": %ld,\n" \
+      "      \"outcomes\": {", (first ? "" : ","), technique_name (t), \
+      technique_latency_[t].count ());
+    for (int o = 0; o < OUTCOME_COUNT; ++o)
+    {
+      fprintf (out, "%s\"%s\": %ld", (o == 0 ? "" : ", "), outcome_name (o), \
+        technique_outcomes_[t][o]);
+    }
+    fprintf (out, "},\n");
+    write_latency (out, technique_latency_[t], "      ");
+    fprintf (out, "\n    }");
+    first = false;
+  }
+  fprintf (out, "\n  ]\n}\n");
+
+  return fclose (out) == 0;
+}
+
+const char* RunReport::outcome_name (const int outcome)
+{
+  static const char* names[OUTCOME_COUNT] = {"solved", "time limit", "node limit", "no solution"};
+
+  return names[outcome];
+}
+
+const char* RunReport::technique_name (const int technique)
+{
+  static const char* names[TECHNIQUE_COUNT] = {"none", "csp", "dlx", "bitboard", "simd"};
+
+  return names[(technique > 0 && technique < TECHNIQUE_COUNT ? technique : 0)];
+}
@@ -0,0 +1,208 @@
+/*
+ * File:   run_report.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Summary of a run: latency distribution, throughput, failures by reason and a breakdown by the
+ * technique that handled each puzzle. Latencies go into log-bucketed histograms in the manner of
+ * HdrHistogram, so that percentiles keep a bounded relative error whatever their magnitude.
+ *
+ * Recording only touches the report it is given. Each worker thread keeps a report of its own and
+ * the reports are merged once the workers are done, so the hot path never takes a lock.
+ */
+
+#ifndef RUN_REPORT_HPP
+#define RUN_REPORT_HPP
+
+#include <vector>
+#include <string>
+#include <ostream>
+
+class LatencyHistogram
+{
+public:
+  /// Each power of two is split into SUB_COUNT / 2 linear buckets, i.e. a relative error of 1/32
+  static const int SUB_BITS = 6;
+  static const long SUB_COUNT = 1L << SUB_BITS;
+  /// Latencies of 2^MAX_BITS ns (about 18 minutes) and above share the last bucket
+  static const int MAX_BITS = 40;
+  static const int BUCKET_COUNT = (MAX_BITS - SUB_BITS + 2) * (SUB_COUNT / 2);
+
+  LatencyHistogram ();
+
+  /*! \brief Clears the histogram.
+   */
+  void clear ();
+
+  /*! \brief Records a latency.
+   *
+   * \param seconds Latency in seconds of type double.
+   */
+  void record (const double seconds);
+
+  /*! \brief Adds the latencies of another histogram.
+   *
+   * \param other Histogram of type LatencyHistogram.
+   */
+  void merge (const LatencyHistogram& other);
+
+  /*! \brief Returns the number of recorded latencies.
+   *
+   * \return Count of type long.
+   */
+  long count () const;
+
+  /*! \brief Returns the smallest recorded latency.
+   *
+   * \return Latency in nanoseconds of type long.
+   */
+  long min () const;
+
+  /*! \brief Returns the largest recorded latency.
+   *
+   * \return Latency in nanoseconds of type long.
+   */
+  long max () const;
+
+  /*! \brief Returns the mean of the recorded latencies.
+   *
+   * \return Latency in nanoseconds of type double.
+   */
+  double mean () const;
+
+  /*! \brief Returns a percentile of the recorded latencies, by nearest rank. The value is the
+   * upper bound of the bucket holding the rank, capped by the largest recorded latency.
+   *
+   * \param fraction Percentile between 0 and 1.
+   *
+   * \return Latency in nanoseconds of type long.
+   */
+  long percentile (const double fraction) const;
+
+  /*! \brief Returns the number of latencies recorded in a bucket.
+   *
+   * \param bucket Bucket index below BUCKET_COUNT.
+   *
+   * \return Count of type long.
+   */
+  long bucket_count (const int bucket) const;
+
+  /*! \brief Returns the smallest latency of a bucket.
+   *
+   * \param bucket Bucket index below BUCKET_COUNT.
+   *
+   * \return Latency in nanoseconds of type long.
+   */
+  static long bucket_lower (const int bucket);
+
+  /*! \brief Returns the largest latency of a bucket.
+   *
+   * \param bucket Bucket index below BUCKET_COUNT.
+   *
+   * \return Latency in nanoseconds of type long.
+   */
+  static long bucket_upper (const int bucket);
+
+private:
+  std::vector <long> counts_;
+  long count_;
+  long min_;
+  long max_;
+  double sum_;
+
+  /*! \brief Returns the bucket of a latency.
+   *
+   * \param nanos Latency in nanoseconds, below 2^MAX_BITS.
+   *
+   * \return Bucket index of type int.
+   */
+  static int bucket (const long nanos);
+};
+
+//==================================================================================================
+//==================================================================================================
+
+class RunReport
+{
+public:
+  /// How a puzzle ended
+  enum Outcome
+  {
+    SOLVED = 0,
+    TIME_LIMIT,
+    NODE_LIMIT,
+    NO_SOLUTION,
+    OUTCOME_COUNT
+  };
+
+  /// Techniques by code, 0 is left for puzzles no technique handled
+  static const int TECHNIQUE_COUNT = 5;
+
+  RunReport ();
+
+  /*! \brief Clears the report.
+   */
+  void clear ();
+
+  /*! \brief Records a puzzle.
+   *
+   * \param technique Code of the technique that handled the puzzle.
+   * \param outcome Outcome of type int, one of Outcome.
+   * \param seconds Solving time of the puzzle.
+   */
+  void record (const int technique, const int outcome, const double seconds);
+
+  /*! \brief Adds the puzzles of another report.
+   *
+   * \param other Report of type RunReport.
+   */
+  void merge (const RunReport& other);
+
+  /*! \brief Set the wall time of the whole run, parsing and output included.
+   *
+   * \param seconds Wall time in seconds.
+   */
+  void set_wall_time (const double seconds);
+
+  /*! \brief Prints the summary of the run.
+   *
+   * \param out Output stream.
+   */
+  void print (std::ostream& out) const;
+
+  /*! \brief Writes the report as a JSON document, with the non-empty buckets of every histogram.
+   *
+   * \param path Output file.
+   *
+   * \return false if the file could not be written, true otherwise.
+   */
+  bool write_json (const std::string& path) const;
+
+  /*! \brief Returns the name of an outcome.
+   *
+   * \param outcome Outcome of type int, one of Outcome.
+   *
+   * \return Name of type const char*.
+   */
+  static const char* outcome_name (const int outcome);
+
+  /*! \brief Returns the name of a technique.
+   *
+   * \param technique Technique code.
+   *
+   * \return Name of type const char*.
+   */
+  static const char* technique_name (const int technique);
+
+private:
+  LatencyHistogram latency_;
+  LatencyHistogram technique_latency_[TECHNIQUE_COUNT];
+  long outcomes_[OUTCOME_COUNT];
+  long technique_outcomes_[TECHNIQUE_COUNT][OUTCOME_COUNT];
+  double solving_time_;
+  double wall_time_;
+};
+
+#endif /// RUN_REPORT_HPP
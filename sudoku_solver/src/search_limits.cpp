@@ -0,0 +1,231 @@
+/*
+ * File:   search_limits.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ */
+
+#include <limits>
+#include <algorithm>
+
+#include "search_limits.hpp"
+
+SearchLimits::SearchLimits ():
+  time_limit_ (0.0),
+  node_limit_ (std::numeric_limits<long>::max ()),
+  cancel_ (NULL),
+  nodes_ (0),
+  cutoff_ (std::numeric_limits<long>::max ()),
+  stop_ (std::numeric_limits<long>::max ()),
+  expired_ (false),
+  cut_off_ (false),
+  counters_ (NULL)
+{}
+
+void SearchLimits::set_time_limit (const double seconds)
+{
+  time_limit_ = seconds;
+}
+
+void SearchLimits::set_node_limit (const long nodes)
+{
+  node_limit_ = (nodes > 0 ? nodes : std::numeric_limits<long>::max ());
+  stop_ = std::min (node_limit_, cutoff_);
+}
+
+void SearchLimits::set_cancel_flag (const std::atomic<bool>* flag)
+{
+  cancel_ = flag;
+}
+
+void SearchLimits::set_counters (const PerfCounters* counters)
+{
+  counters_ = counters;
+}
+
+void SearchLimits::start ()
+{
+  nodes_ = 0;
+  expired_ = false;
+  cut_off_ = false;
+  stats_.clear ();
+  times_.clear ();
+  if (counters_ != NULL)
+  {
+    counters_->read (lap_counters_);
+  }
+  if (AllocCounter::enabled ())
+  {
+    lap_allocations_ = AllocCounter::current ();
+  }
+  started_ = std::chrono::steady_clock::now ();
+  lap_ = started_;
+  cutoff_ = std::numeric_limits<long>::max ();
+  stop_ = node_limit_;
+  if (time_limit_ > 0.0)
+  {
+    deadline_ = lap_ + \
+    std::chrono::duration_cast<std::chrono::steady_clock::duration> (
+      std::chrono::duration<double> (time_limit_));
+  }
+}
+
+void SearchLimits::restart (const long nodes)
+{
+  /// Only a cut off run may be resumed, the limits of the puzzle stay expired
+  if (cut_off_)
+  {
+    expired_ = false;
+    cut_off_ = false;
+  }
+  cutoff_ = (nodes > 0 && nodes < std::numeric_limits<long>::max () - nodes_ ? nodes_ + nodes :
+    std::numeric_limits<long>::max ());
+  stop_ = std::min (node_limit_, cutoff_);
+}
+
+void SearchLimits::lap (const int phase)
+{
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now ();
+
+  times_.seconds[phase] += std::chrono::duration<double> (now - lap_).count ();
+  lap_ = now;
+  if (counters_ != NULL)
+  {
+    CounterValues counts;
+
+    counters_->read (counts);
+    for (int e = 0; e < CounterValues::EVENT_COUNT; ++e)
+    {
+      times_.counters[phase].values[e] += counts.values[e] - lap_counters_.values[e];
+    }
+    lap_counters_ = counts;
+  }
+  if (AllocCounter::enabled ())
+  {
+    times_.allocations[phase].add (AllocCounter::since (lap_allocations_));
+    lap_allocations_ = AllocCounter::current ();
+  }
+}
+
+const PhaseTimes& SearchLimits::times () const
+{
+  return times_;
+}
+
+std::chrono::steady_clock::time_point SearchLimits::started () const
+{
+  return started_;
+}
+
+bool SearchLimits::expired () const
+{
+  return expired_;
+}
+
+bool SearchLimits::cut_off () const
+{
+  return cut_off_;
+}
+
+bool SearchLimits::out_of_nodes () const
+{
+  return nodes_ > node_limit_;
+}
+
+long SearchLimits::nodes () const
+{
+  return nodes_;
+}
+
+void SearchLimits::check ()
+{
+  if (nodes_ > node_limit_)
+  {
+    expired_ = true;
+  }
+  else if (nodes_ > cutoff_)
+  {
+    expired_ = true;
+    cut_off_ = true;
+  }
+  else if (time_limit_ > 0.0 && std::chrono::steady_clock::now () >= deadline_)
+  {
+    expired_ = true;
+  }
+  else if (cancel_ != NULL && cancel_->load (std::memory_order_relaxed))
+  {
+    expired_ = true;
+  }
+}
+
+//==================================================================================================
+//==================================================================================================
+
+const double RestartSchedule::GROWTH = 1.5;
+
+RestartSchedule::RestartSchedule ():
+  kind_ (NONE),
+  base_ (0),
+  run_ (0)
+{}
+
+void RestartSchedule::set (const int kind, const long base)
+{
+  kind_ = kind;
+  base_ = (base > 0 ? base : 1);
+}
+
+bool RestartSchedule::enabled () const
+{
+  return kind_ != NONE;
+}
+
+void RestartSchedule::reset ()
+{
+  run_ = 0;
+}
+
+long RestartSchedule::next ()
+{
+  double budget = base_;
+
+  ++run_;
+  if (kind_ == LUBY)
+  {
+    return base_ * luby (run_);
+  }
+  else if (kind_ == GEOMETRIC)
+  {
+    for (long i = 1; i < run_; ++i)
+    {
+      budget *= GROWTH;
+    }
+    /// Past this point the run is as good as unlimited
+    return (budget < std::numeric_limits<long>::max () / 2 ? (long) budget : 0);
+  }
+
+  return 0;
+}
+
+long RestartSchedule::luby (long i)
+{
+  long size = 1;
+
+  /// Find the smallest complete subsequence 2^k - 1 terms long that holds term i, the last term
+  /// of each one is 2^(k - 1) and the rest repeats the previous subsequence twice
+  while (size < i)
+  {
+    size = 2 * size + 1;
+  }
+  while (size != i)
+  {
+    size = (size - 1) / 2;
+    if (i > size)
+    {
+      i -= size;
+    }
+  }
+
+  return (size + 1) / 2;
+}
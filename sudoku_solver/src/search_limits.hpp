@@ -0,0 +1,382 @@
+/*
+ * File:   search_limits.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Per-puzzle search budget shared by the solving techniques. The engines call tick () once per
+ * search node and abandon the search as soon as it returns false.
+ *
+ * A puzzle may also be searched in several runs, each one cut off after a number of nodes given by
+ * a restart schedule (see RestartSchedule), so that an unlucky early guess does not cost the whole
+ * budget.
+ */
+
+#ifndef SEARCH_LIMITS_HPP
+#define SEARCH_LIMITS_HPP
+
+#include <atomic>
+#include <chrono>
+
+#include "perf_counters.hpp"
+#include "alloc_counter.hpp"
+
+/// Effort spent on a single puzzle, gathered by the engines alongside the node count
+struct SearchStats
+{
+  /// Values tried at branching points
+  long guesses;
+  /// Guesses that did not end the search
+  long backtracks;
+  /// Largest number of guesses on a single path
+  int max_depth;
+  /// Cells solved by propagation, i.e. neither given nor guessed
+  long propagations;
+  /// Columns covered by Algorithm X, each one is uncovered again
+  long covers;
+  /// Choices available at the branching points, added up
+  long choices;
+
+  SearchStats ()
+  {
+    clear ();
+  }
+
+  void clear ()
+  {
+    guesses = 0;
+    backtracks = 0;
+    max_depth = 0;
+    propagations = 0;
+    covers = 0;
+    choices = 0;
+  }
+
+  void add (const SearchStats& other)
+  {
+    guesses += other.guesses;
+    backtracks += other.backtracks;
+    max_depth = (other.max_depth > max_depth ? other.max_depth : max_depth);
+    propagations += other.propagations;
+    covers += other.covers;
+    choices += other.choices;
+  }
+
+  /// Accounts for a branching point with the given number of choices, depth guesses deep
+  inline void branch (const int count, const int depth)
+  {
+    choices += count;
+    max_depth = (depth > max_depth ? depth : max_depth);
+  }
+
+  /// Accounts for a guess and the cells its propagation solved
+  inline void guess (const int forced)
+  {
+    ++guesses;
+    propagations += (forced > 0 ? forced : 0);
+  }
+};
+
+//==================================================================================================
+//==================================================================================================
+
+/// Time spent on a single puzzle by phase, in seconds of the monotonic clock
+struct PhaseTimes
+{
+  enum Phase
+  {
+    PARSE = 0,
+    SETUP,
+    PROPAGATE,
+    SEARCH,
+    OUTPUT,
+    PHASE_COUNT
+  };
+
+  double seconds[PHASE_COUNT];
+  /// Hardware events of each phase, only counted while the solver has counters open
+  CounterValues counters[PHASE_COUNT];
+  /// Memory allocated in each phase, only counted while allocation counting is enabled
+  AllocCounts allocations[PHASE_COUNT];
+
+  PhaseTimes ()
+  {
+    clear ();
+  }
+
+  void clear ()
+  {
+    for (int p = 0; p < PHASE_COUNT; ++p)
+    {
+      seconds[p] = 0.0;
+      counters[p].clear ();
+      allocations[p].clear ();
+    }
+  }
+
+  /// Clears every phase but parsing, which is over by the time a puzzle is solved
+  void clear_solving ()
+  {
+    const double parse = seconds[PARSE];
+    const AllocCounts parse_allocations = allocations[PARSE];
+
+    clear ();
+    seconds[PARSE] = parse;
+    allocations[PARSE] = parse_allocations;
+  }
+
+  void add (const PhaseTimes& other)
+  {
+    for (int p = 0; p < PHASE_COUNT; ++p)
+    {
+      seconds[p] += other.seconds[p];
+      counters[p].add (other.counters[p]);
+      allocations[p].add (other.allocations[p]);
+    }
+  }
+
+  /// Time spent solving, i.e. neither parsing nor writing
+  double solving () const
+  {
+    return seconds[SETUP] + seconds[PROPAGATE] + seconds[SEARCH];
+  }
+
+  /// Memory allocated in the solving phases
+  AllocCounts solving_allocations () const
+  {
+    AllocCounts total = allocations[SETUP];
+
+    total.add (allocations[PROPAGATE]);
+    total.add (allocations[SEARCH]);
+
+    return total;
+  }
+
+  /// Hardware events of the solving phases
+  CounterValues solving_counters () const
+  {
+    CounterValues total;
+
+    total.add (counters[SETUP]);
+    total.add (counters[PROPAGATE]);
+    total.add (counters[SEARCH]);
+
+    return total;
+  }
+
+  static const char* name (const int phase)
+  {
+    static const char* names[PHASE_COUNT] = {"parse", "setup", "propagate", "search", "output"};
+
+    return names[phase];
+  }
+};
+
+//==================================================================================================
+//==================================================================================================
+
+class SearchLimits
+{
+public:
+  /*! \brief Constructor of SearchLimits. By default no limit is imposed.
+   */
+  SearchLimits ();
+
+  /*! \brief Set the wall-time limit of a single puzzle.
+   *
+   * \param seconds Time limit in seconds of type double. Zero or less disables the limit.
+   */
+  void set_time_limit (const double seconds);
+
+  /*! \brief Set the maximum number of search nodes of a single puzzle.
+   *
+   * \param nodes Node limit of type long. Zero or less disables the limit.
+   */
+  void set_node_limit (const long nodes);
+
+  /*! \brief Set an external flag that cancels the search once raised.
+   *
+   * \param flag Pointer to cancellation flag. NULL disables cancellation.
+   */
+  void set_cancel_flag (const std::atomic<bool>* flag);
+
+  /*! \brief Set the hardware counters read at each lap, along with the clock. They must be open
+   * in the thread that searches.
+   *
+   * \param counters Pointer to counters. NULL disables counting.
+   */
+  void set_counters (const PerfCounters* counters);
+
+  /*! \brief Resets the node counter, the statistics and the phase times and starts the clock.
+   * Must be called before each puzzle.
+   */
+  void start ();
+
+  /*! \brief Charges the time since the previous lap, or since start (), to a phase, as well as
+   * the hardware events if counters are set and the allocations if they are counted.
+   *
+   * \param phase Phase of type int, one of PhaseTimes::Phase.
+   */
+  void lap (const int phase);
+
+  /*! \brief Returns the phase times recorded since the last call to start ().
+   *
+   * \return Phase times of type PhaseTimes.
+   */
+  const PhaseTimes& times () const;
+
+  /*! \brief Returns the time of the last call to start ().
+   *
+   * \return Point in time of the monotonic clock.
+   */
+  std::chrono::steady_clock::time_point started () const;
+
+  /*! \brief Starts a new run of the current puzzle, cut off after the given number of search
+   * nodes. The time and node limits of the puzzle keep running across runs.
+   *
+   * \param nodes Node budget of the run of type long. Zero or less lets the run go on until the
+   * limits of the puzzle are reached.
+   */
+  void restart (const long nodes);
+
+  /*! \brief Accounts for one search node.
+   *
+   * \return false if a limit has been reached and the search must stop, true otherwise.
+   */
+  inline bool tick ()
+  {
+    ++nodes_;
+    if ((nodes_ & CHECK_MASK) == 0 || nodes_ > stop_)
+    {
+      check ();
+    }
+
+    return !expired_;
+  }
+
+  /*! \brief Returns whether a limit has been reached since the last call to start ().
+   *
+   * \return Status of type bool.
+   */
+  bool expired () const;
+
+  /*! \brief Returns whether the current run was stopped by its own node budget rather than by
+   * the limits of the puzzle, in which case the puzzle may be searched again.
+   *
+   * \return Status of type bool.
+   */
+  bool cut_off () const;
+
+  /*! \brief Returns whether the node limit of the puzzle has been reached since the last call to
+   * start ().
+   *
+   * \return Status of type bool.
+   */
+  bool out_of_nodes () const;
+
+  /*! \brief Returns the number of search nodes visited since the last call to start ().
+   *
+   * \return Node count of type long.
+   */
+  long nodes () const;
+
+  /*! \brief Returns the search statistics gathered since the last call to start (). Engines add
+   * to them as they go.
+   *
+   * \return Statistics of type SearchStats.
+   */
+  inline SearchStats& stats ()
+  {
+    return stats_;
+  }
+
+private:
+  /// The clock and cancellation flag are only polled every CHECK_MASK + 1 nodes
+  static const long CHECK_MASK = 255;
+  double time_limit_;
+  long node_limit_;
+  const std::atomic<bool>* cancel_;
+  long nodes_;
+  /// Node count at which the current run is cut off
+  long cutoff_;
+  /// Lowest of node_limit_ and cutoff_
+  long stop_;
+  bool expired_;
+  bool cut_off_;
+  std::chrono::steady_clock::time_point deadline_;
+  SearchStats stats_;
+  PhaseTimes times_;
+  const PerfCounters* counters_;
+  /// Hardware events at the end of the previous lap
+  CounterValues lap_counters_;
+  /// Allocations at the end of the previous lap
+  AllocCounts lap_allocations_;
+  std::chrono::steady_clock::time_point started_;
+  /// End of the previous lap
+  std::chrono::steady_clock::time_point lap_;
+
+  /*! \brief Polls the node limit, the clock and the cancellation flag.
+   */
+  void check ();
+};
+
+//==================================================================================================
+//==================================================================================================
+
+class RestartSchedule
+{
+public:
+  /// Growth of the node budget from one run to the next
+  enum Kind
+  {
+    NONE = 0,
+    LUBY,
+    GEOMETRIC
+  };
+
+  /*! \brief Constructor of RestartSchedule. By default a puzzle is searched in a single run.
+   */
+  RestartSchedule ();
+
+  /*! \brief Set the schedule.
+   *
+   * \param kind Schedule kind of type int, one of Kind.
+   * \param base Node budget of the first run of type long.
+   */
+  void set (const int kind, const long base);
+
+  /*! \brief Returns whether puzzles are searched in several runs.
+   *
+   * \return Status of type bool.
+   */
+  bool enabled () const;
+
+  /*! \brief Rewinds the schedule to its first run. Must be called before each puzzle.
+   */
+  void reset ();
+
+  /*! \brief Returns the node budget of the next run and moves on to the following one. The
+   * budgets grow without bound, so a puzzle is always searched to completion eventually.
+   *
+   * \return Node budget of type long. Zero means no budget.
+   */
+  long next ();
+
+  /*! \brief Returns the i-th term of the Luby sequence 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, ...
+   *
+   * \param i Index of the term, starting at 1.
+   *
+   * \return Term of type long.
+   */
+  static long luby (long i);
+
+private:
+  /// Ratio of consecutive budgets of the geometric schedule
+  static const double GROWTH;
+  int kind_;
+  long base_;
+  long run_;
+};
+
+#endif /// SEARCH_LIMITS_HPP
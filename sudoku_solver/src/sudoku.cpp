@@ -0,0 +1,203 @@
+/*
+ * File:   sudoku.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ */
+
+#include <memory>
+
+#include "sudoku.hpp"
+#include "sudoku_solver.hpp"
+
+namespace sudoku
+{
+
+Options::Options ():
+  technique (1),
+  box_rows (3),
+  box_cols (3),
+  level (CSPRules::SINGLES),
+  value_order (CSPRules::NATURAL),
+  seed (1),
+  time_limit (0.0),
+  node_limit (0),
+  solution_limit (1),
+  restarts (RestartSchedule::NONE),
+  restart_base (100),
+  table_bytes (0),
+  nogoods (0),
+  nogood_length (16),
+  cancel (NULL)
+{
+}
+
+Stats::Stats ():
+  status (INVALID_INPUT),
+  technique (0),
+  solutions (0),
+  nodes (0),
+  restarts (0),
+  seconds (0.0),
+  guesses (0),
+  backtracks (0),
+  max_depth (0),
+  propagations (0),
+  covers (0),
+  choices (0)
+{
+}
+
+/// The setters of SudokuSolver warn on the console about invalid values, so they are only ever
+/// given values checked here first
+static bool valid_options (const Options& options)
+{
+  if (options.technique < 1 || options.technique > 4)
+  {
+    return false;
+  }
+  if (options.box_rows < 2 || options.box_cols < 2 ||
+    options.box_rows * options.box_cols > MAX_GRID_SIZE)
+  {
+    return false;
+  }
+  if (options.level < CSPRules::SINGLES || options.level > CSPRules::FISH)
+  {
+    return false;
+  }
+  if (options.value_order < CSPRules::NATURAL || options.value_order > CSPRules::RANDOM)
+  {
+    return false;
+  }
+  if (options.restarts < RestartSchedule::NONE || options.restarts > RestartSchedule::GEOMETRIC ||
+    options.restart_base <= 0)
+  {
+    return false;
+  }
+  if (options.table_bytes < 0 || options.nogoods < 0 || options.nogood_length < 0)
+  {
+    return false;
+  }
+
+  return (options.time_limit >= 0.0 && options.node_limit >= 0 && options.solution_limit > 0);
+}
+
+/// Solver bound to the calling thread by a SolverBinding, if any. It is set up from the options
+/// like any other, the binding only decides where the statistics of the run are kept.
+static thread_local SudokuSolver* bound_solver = NULL;
+
+int solve (const uint8_t* cells, uint8_t* out, const Options& options, Stats* stats)
+{
+  /// Every thread solves with a solver of its own, so calls share nothing but the static tables
+  static thread_local std::unique_ptr <SudokuSolver> own_solver;
+  SudokuSolver* solver = bound_solver;
+  const int grid_size = options.box_rows * options.box_cols;
+  Puzzle puzzle;
+  int status = INVALID_INPUT;
+
+  if (stats != NULL)
+  {
+    *stats = Stats ();
+  }
+  if (cells == NULL || !valid_options (options))
+  {
+    return status;
+  }
+  for (int k = 0; k < grid_size * grid_size; ++k)
+  {
+    if (cells[k] > grid_size)
+    {
+      return status;
+    }
+  }
+
+  if (solver == NULL && own_solver == nullptr)
+  {
+    own_solver.reset (new SudokuSolver ());
+    own_solver->init ();
+    own_solver->toggle_quiet (true);
+  }
+  if (solver == NULL)
+  {
+    solver = own_solver.get ();
+  }
+  /// The box geometry comes with the puzzle, the one of the solver is only used to parse files
+  solver->set_technique (options.technique);
+  solver->set_propagation_level (options.level);
+  solver->set_value_order (options.value_order);
+  solver->set_seed (options.seed);
+  solver->set_time_limit (options.time_limit);
+  solver->set_node_limit (options.node_limit);
+  solver->set_solution_limit (options.solution_limit);
+  solver->set_restarts (options.restarts, options.restart_base);
+  solver->set_table_size (options.table_bytes);
+  solver->set_nogood_limits (options.nogoods, options.nogood_length);
+  solver->set_cancel_flag (options.cancel);
+
+  puzzle.clear ();
+  puzzle.box_rows = options.box_rows;
+  puzzle.box_cols = options.box_cols;
+  puzzle.index = 1;
+  puzzle.input_grid.assign (grid_size, std::vector <int> (grid_size, 0));
+  for (int i = 0; i < grid_size; ++i)
+  {
+    for (int j = 0; j < grid_size; ++j)
+    {
+      puzzle.input_grid[i][j] = cells[i * grid_size + j];
+    }
+  }
+  puzzle.output_grid = puzzle.input_grid;
+  solver->solve_puzzle (puzzle);
+
+  /// The outcomes of RunReport are listed in the same order as Status
+  status = puzzle.outcome;
+  if (puzzle.solved && out != NULL)
+  {
+    for (int i = 0; i < grid_size; ++i)
+    {
+      for (int j = 0; j < grid_size; ++j)
+      {
+        out[i * grid_size + j] = (uint8_t) puzzle.output_grid[i][j];
+      }
+    }
+  }
+  if (stats != NULL)
+  {
+    stats->status = status;
+    stats->technique = puzzle.technique;
+    stats->solutions = puzzle.solution_count;
+    stats->nodes = puzzle.nodes;
+    stats->restarts = puzzle.restarts;
+    stats->seconds = puzzle.proc_time;
+    stats->guesses = puzzle.stats.guesses;
+    stats->backtracks = puzzle.stats.backtracks;
+    stats->max_depth = puzzle.stats.max_depth;
+    stats->propagations = puzzle.stats.propagations;
+    stats->covers = puzzle.stats.covers;
+    stats->choices = puzzle.stats.choices;
+  }
+
+  return status;
+}
+
+const char* status_name (const int status)
+{
+  static const char* names[] = {"solved", "time limit", "node limit", "no solution",
+    "invalid input"};
+
+  return (status >= SOLVED && status <= INVALID_INPUT ? names[status] : "unknown");
+}
+
+} /// namespace sudoku
+
+SolverBinding::SolverBinding (SudokuSolver& solver):
+  previous_ (sudoku::bound_solver)
+{
+  sudoku::bound_solver = &solver;
+}
+
+SolverBinding::~SolverBinding ()
+{
+  sudoku::bound_solver = previous_;
+}
@@ -0,0 +1,122 @@
+/*
+ * File:   sudoku.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * The interface of the solver library, for programs that embed it. Puzzles are solved in memory,
+ * without any file or console I/O, and solve () may be called from any number of threads at once:
+ * each thread keeps a solver of its own, built on its first call and reused by the following ones.
+ *
+ * Only the declarations in this file are exported by the shared library.
+ */
+
+#ifndef SUDOKU_HPP
+#define SUDOKU_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define SUDOKU_API __attribute__ ((visibility ("default")))
+
+namespace sudoku
+{
+
+/// Largest grid a puzzle may have, in cells per row
+const int MAX_GRID_SIZE = 64;
+
+/// How a call to solve () ended
+enum Status
+{
+  SOLVED = 0,
+  TIME_LIMIT,
+  NODE_LIMIT,
+  NO_SOLUTION,
+  INVALID_INPUT
+};
+
+/// Settings of a call to solve (), the same as the options of the command-line tool
+struct SUDOKU_API Options
+{
+  /// 1 for CSP, 2 for DLX, 3 for bitboard, 4 for SIMD bitboard. Techniques 3 and 4 only handle
+  /// 9x9 puzzles and leave the others to DLX.
+  int technique;
+  /// Box geometry, the grid being box_rows * box_cols cells wide
+  int box_rows;
+  int box_cols;
+  /// Propagation level and value order of the CSP technique, from 0 to 3 each
+  int level;
+  int value_order;
+  /// Seed of the randomized parts of the search
+  unsigned int seed;
+  /// Limits of the search, zero meaning no limit
+  double time_limit;
+  long node_limit;
+  /// Number of solutions to count. The first one is the one returned.
+  int solution_limit;
+  /// Restart schedule of techniques 1 and 2, 0 for a single run, 1 for Luby and 2 for geometric
+  /// growth, and node budget of the first run
+  int restarts;
+  long restart_base;
+  /// Memory budget of the transposition table of technique 1 in bytes, zero for none. A thread
+  /// keeps its table from one call to the next as long as the budget stays the same.
+  long table_bytes;
+  /// Maximum number of nogoods learned by technique 1, zero for none, and of decisions in each
+  int nogoods;
+  int nogood_length;
+  /// Flag that cancels the search once raised from another thread, NULL for none. It is polled
+  /// every few hundred search nodes, and a cancelled search ends with TIME_LIMIT.
+  const std::atomic<bool>* cancel;
+
+  Options ();
+};
+
+/// Effort spent on a call to solve ()
+struct SUDOKU_API Stats
+{
+  /// One of Status
+  int status;
+  /// Technique that handled the puzzle, 0 if none did
+  int technique;
+  int solutions;
+  long nodes;
+  int restarts;
+  /// Solving time, not counting the setup of the solver on the first call of a thread
+  double seconds;
+  long guesses;
+  long backtracks;
+  int max_depth;
+  long propagations;
+  long covers;
+  long choices;
+
+  Stats ();
+};
+
+/*! \brief Solves a puzzle. Never prints anything and never throws but for a failure to allocate.
+ *
+ * \param cells Clues of the puzzle, row by row, with 0 for empty cells. Holds grid * grid cells,
+ * grid being options.box_rows * options.box_cols.
+ * \param out Receives the solution in the same layout when the puzzle is solved, and is left
+ * untouched otherwise. May be NULL to only count solutions.
+ * \param options Settings of type Options.
+ * \param stats Receives the effort spent when not NULL.
+ *
+ * \return One of Status.
+ */
+SUDOKU_API int solve (const uint8_t* cells, uint8_t* out, const Options& options = Options (),
+  Stats* stats = NULL);
+
+/*! \brief Returns the name of a status.
+ *
+ * \param status One of Status.
+ *
+ * \return Name of type const char*.
+ */
+SUDOKU_API const char* status_name (const int status);
+
+} /// namespace sudoku
+
+#endif /// SUDOKU_HPP
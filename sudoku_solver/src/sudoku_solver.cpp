@@ -7,32 +7,240 @@
  */
 
 #include <string.h>
-#include <sys/time.h>
+#include <stdio.h>
 #include <time.h>
 #include <memory>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
+#include "sudoku.hpp"
 #include "sudoku_solver.hpp"
 #include "constraint_propagation.hpp"
+#include "bitboard_propagation.hpp"
 
 const static int CSP_TECH = 1; 
 const static int DLX_TECH = 2;
+const static int BIT_TECH = 3;
+const static int SIMD_TECH = 4;
+
+/// Puzzles are handed out to the generator threads in chunks of this size
+const static int GENERATE_CHUNK = 16;
+/// Chunks generated ahead of the one being written, per thread
+const static int GENERATE_AHEAD = 4;
+/// Solutions tried per puzzle before settling for more clues than the target
+const static int GENERATE_ATTEMPTS = 20;
+
+/*! \brief Returns the time elapsed since a point of the monotonic clock.
+ *
+ * \param then Point in time.
+ *
+ * \return Elapsed time in seconds.
+ */
+static double seconds_since (const std::chrono::steady_clock::time_point& then)
+{
+  return std::chrono::duration<double> (std::chrono::steady_clock::now () - then).count ();
+}
+
+/*! \brief Formats a duration with nanosecond digits, the resolution of the monotonic clock.
+ *
+ * \param seconds Duration in seconds.
+ *
+ * \return Formatted duration of type std::string.
+ */
+static std::string format_seconds (const double seconds)
+{
+  char text[32];
+
+  snprintf (text, sizeof (text), "%.9f", seconds);
+
+  return text;
+}
+
+/*! \brief Formats hardware event counts, with the instructions per cycle.
+ *
+ * \param counts Event counts.
+ *
+ * \return Formatted counts of type std::string.
+ */
+static std::string format_counters (const CounterValues& counts)
+{
+  char ipc[16];
+  std::string text;
+
+  for (int e = 0; e < CounterValues::EVENT_COUNT; ++e)
+  {
+    text += std::string (e == 0 ? "" : ", ") + CounterValues::name (e) + " " + \
+    std::to_string (counts.values[e]);
+    if (e == CounterValues::INSTRUCTIONS)
+    {
+      snprintf (ipc, sizeof (ipc), "%.2f", counts.ipc ());
+      text += std::string (", IPC ") + ipc;
+    }
+  }
+
+  return text;
+}
+
+/*! \brief Formats allocation counts.
+ *
+ * \param counts Allocation counts.
+ *
+ * \return Formatted counts of type std::string.
+ */
+static std::string format_allocations (const AllocCounts& counts)
+{
+  return std::to_string (counts.allocations) + " (" + std::to_string (counts.bytes) + " bytes)";
+}
+
+/// Chunks of generated puzzles on their way from the generator threads to the writer
+struct GeneratorQueue
+{
+  std::mutex lock;
+  std::condition_variable changed;
+  std::map <long, std::string> done;
+  long chunks;
+  long next;
+  long written;
+  long window;
+  long above;
+  bool failed;
+};
+
+/*! \brief Generates chunks of puzzles in the input format until none is left.
+ *
+ * \param queue Queue shared with the other threads.
+ * \param box_rows Height of a box of type int.
+ * \param box_cols Width of a box of type int.
+ * \param seed Seed of the run.
+ * \param count Number of puzzles of the run.
+ * \param clues Target number of clues.
+ */
+static void generate_chunks (GeneratorQueue* queue, const int box_rows, const int box_cols,
+  const unsigned int seed, const long count, const int clues)
+{
+  PuzzleGenerator generator;
+  std::vector <std::vector <int> > puzzle;
+  std::vector <std::vector <int> > best;
+
+  generator.init (box_rows, box_cols);
+  while (true)
+  {
+    std::string text;
+    long chunk = 0;
+    long above = 0;
+    bool failed = false;
+
+    {
+      std::unique_lock <std::mutex> guard (queue->lock);
+
+      /// Stay within a window of the writer, so that memory does not grow with the count
+      queue->changed.wait (guard, [queue] () {
+        return queue->failed || queue->next >= queue->chunks || \
+        queue->next < queue->written + queue->window;
+      });
+      if (queue->failed || queue->next >= queue->chunks)
+      {
+        return;
+      }
+      chunk = queue->next++;
+    }
+    const std::chrono::steady_clock::time_point begin = (Trace::enabled () ? \
+    std::chrono::steady_clock::now () : std::chrono::steady_clock::time_point ());
+
+    for (long p = chunk * GENERATE_CHUNK; p < std::min (count, (chunk + 1) * GENERATE_CHUNK) && \
+      !failed; ++p)
+    {
+      int fewest = 0;
+
+      generator.seed (seed, p);
+      for (int attempt = 0; attempt < GENERATE_ATTEMPTS && \
+        (fewest == 0 || (clues > 0 && fewest > clues)); ++attempt)
+      {
+        const int found = generator.generate (clues, puzzle);
+
+        if (found != 0 && (fewest == 0 || found < fewest))
+        {
+          fewest = found;
+          best.swap (puzzle);
+        }
+      }
+      failed = (fewest == 0);
+      above += (clues > 0 && fewest > clues);
+      for (unsigned int i = 0; i < best.size () && !failed; ++i)
+      {
+        for (unsigned int j = 0; j < best[i].size (); ++j)
+        {
+          text += std::to_string (best[i][j]);
+          text += (j + 1 < best[i].size () ? ',' : '\n');
+        }
+      }
+      text += '\n';
+    }
+    if (Trace::enabled ())
+    {
+      Trace::span ("chunk", "generate", begin, std::chrono::steady_clock::now (), chunk, NULL, \
+        NULL, "puzzles", std::min (count, (chunk + 1) * GENERATE_CHUNK) - chunk * GENERATE_CHUNK);
+    }
+    {
+      std::lock_guard <std::mutex> guard (queue->lock);
+
+      queue->done[chunk].swap (text);
+      queue->above += above;
+      queue->failed = (queue->failed || failed);
+    }
+    queue->changed.notify_all ();
+  }
+}
 
 SudokuSolver::SudokuSolver ():
   print_time_ (false),
+  print_stats_ (false),
+  print_counters_ (false),
+  print_allocations_ (false),
   technique_ (CSP_TECH),
-  grid_size_ (9),
+  box_rows_ (3),
+  box_cols_ (3),
+  auto_size_ (true),
+  solution_limit_ (1),
+  time_limit_ (0.0),
+  node_limit_ (0),
+  restart_kind_ (RestartSchedule::NONE),
+  restart_base_ (1),
+  table_bytes_ (0),
+  nogood_count_ (0),
+  nogood_length_ (0),
   ready_ (false),
-  display_ (false)
+  display_ (false),
+  quiet_ (false),
+  batch_ (false),
+  seed_ (1),
+  threads_ (0)
 {}
 
+/*! \brief Builds the lookup tables shared by every solver instance. They are read-only once built.
+ */
+static void init_tables ()
+{
+  CSPSolver<3, 3>::init ();
+  CSPSolver<2, 5>::init ();
+  CSPSolver<3, 4>::init ();
+  CSPSolver<4, 4>::init ();
+  CSPSolver<5, 5>::init ();
+  CSPSolver<6, 6>::init ();
+  BitboardSolver::init ();
+}
+
 bool SudokuSolver::init ()
 {
-  if (!ec_solver_.init (grid_size_))
-  {
-    std::cout << "ERROR! Could not initialize Sudoko DLX solver." << std::endl;
-    return false;
-  }
-  CSPSolver::init ();
+  static std::once_flag tables;
+
+  /// Solvers may be initialized from several threads at once, the tables are built only once
+  std::call_once (tables, init_tables);
+  /// The DLX solver is sized on demand, once the grid size of the input is known
+  simd_solver_.set_vectorized (true);
   ready_ = true;
   
   return true;
@@ -48,6 +256,14 @@ void SudokuSolver::solve (std::string infile, std::string outfile)
   std::vector <Puzzle> puzzles;
   std::ofstream out;
   int win_count = 0;
+  int timeout_count = 0;
+  int unique_count = 0;
+  long node_count = 0;
+  long restart_count = 0;
+  SearchStats stats;
+  PhaseTimes times;
+  RunReport report;
+  const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now ();
   /// Check if ready
   if (!ready_)
   {
@@ -59,27 +275,75 @@ void SudokuSolver::solve (std::string infile, std::string outfile)
   {
     return;
   }
-  /// Solve puzzle(s) using the selected technique
+  csp_rules_.clear ();
+  table_.clear ();
+  nogoods_.clear ();
+  if (technique_ == SIMD_TECH)
+  {
+    std::cout << "Using " << simd_solver_.kernel_name () << " propagation kernel." << std::endl;
+  }
+  /// Solve puzzle(s) using the selected technique, one at a time through the library interface
+  SolverBinding binding (*this);
+
   for (unsigned int i = 0; i < puzzles.size (); ++i)
   {
-    std::cout << "Solving puzzle: " << i + 1 << std::endl;
-    if (technique_ == DLX_TECH || grid_size_ > 9)
+    if (batch_ && technique_ == SIMD_TECH && puzzles[i].grid_size () == 9)
     {
-      solve_EC (puzzles[i]);
-    }
-    else if (technique_ == CSP_TECH)
-    {
-      sovle_CSP (puzzles[i]);
+      int count = 1;
+
+      /// A slice only holds 9x9 puzzles, any other puzzle is solved on its own
+      while (count < simd_solver_.batch_width () && i + count < puzzles.size () \
+        && puzzles[i + count].grid_size () == 9)
+      {
+        ++count;
+      }
+      solve_batch (puzzles, i, count);
+      i += count - 1;
+      continue;
     }
+    std::cout << "Solving puzzle: " << i + 1 << std::endl;
+    solve_library (puzzles[i]);
   }
   /// Output puzzle(s)
   out.open (outfile);
   for (unsigned int i = 0; i < puzzles.size (); ++i)
   {
+    const std::chrono::steady_clock::time_point then = std::chrono::steady_clock::now ();
+    const AllocCounts allocated = AllocCounter::current ();
+
+    if (solution_limit_ > 1 && !puzzles[i].timed_out)
+    {
+      output_solution_count (puzzles[i], out);
+    }
+    if (print_stats_)
+    {
+      output_stats (puzzles[i], out);
+    }
+    if (print_counters_)
+    {
+      output_counters (puzzles[i], out);
+    }
+    if (print_allocations_)
+    {
+      output_allocations (puzzles[i], out);
+    }
     if (puzzles[i].solved)
     {
       output_puzzle (puzzles[i], out);
       ++win_count;
+      if (puzzles[i].solution_count == 1)
+      {
+        ++unique_count;
+      }
+    }
+    else if (puzzles[i].timed_out)
+    {
+      out << "+++++ Puzzle timed out. +++++\n";
+      if (display_)
+      {
+        std::cout << "Puzzle timed out." << std::endl;
+      }
+      ++timeout_count;
     }
     else
     {
@@ -94,9 +358,211 @@ void SudokuSolver::solve (std::string infile, std::string outfile)
     {
       std::cout << std::endl;
     }
+    node_count += puzzles[i].nodes;
+    restart_count += puzzles[i].restarts;
+    stats.add (puzzles[i].stats);
+    report.record (puzzles[i].technique, puzzles[i].outcome, puzzles[i].proc_time);
+    puzzles[i].times.seconds[PhaseTimes::OUTPUT] = seconds_since (then);
+    puzzles[i].times.allocations[PhaseTimes::OUTPUT] = AllocCounter::since (allocated);
+    if (Trace::enabled ())
+    {
+      Trace::span ("output", "phase", then, std::chrono::steady_clock::now (), puzzles[i].index);
+    }
+    times.add (puzzles[i].times);
   }
   out.close ();
   std::cout << "Solved " << win_count << " puzzle(s)" << std::endl;
+  if (timeout_count > 0)
+  {
+    std::cout << "Timed out on " << timeout_count << " puzzle(s)" << std::endl;
+  }
+  if (solution_limit_ > 1)
+  {
+    std::cout << "Unique solution in " << unique_count << " puzzle(s)" << std::endl;
+  }
+  std::cout << "Search nodes: " << node_count << std::endl;
+  if (print_stats_)
+  {
+    std::cout << "Search statistics:" << std::endl;
+    std::cout << "  Guesses: " << stats.guesses << std::endl;
+    std::cout << "  Backtracks: " << stats.backtracks << std::endl;
+    std::cout << "  Maximum depth: " << stats.max_depth << std::endl;
+    std::cout << "  Propagated cells: " << stats.propagations << std::endl;
+    std::cout << "  Column covers: " << stats.covers << std::endl;
+    std::cout << "  Branching choices: " << stats.choices << std::endl;
+  }
+  if (print_counters_)
+  {
+    std::cout << "Hardware counters: " << format_counters (times.solving_counters ()) << std::endl;
+    for (int p = PhaseTimes::SETUP; p <= PhaseTimes::SEARCH; ++p)
+    {
+      std::cout << "  " << PhaseTimes::name (p) << ": " << format_counters (times.counters[p]) \
+      << std::endl;
+    }
+  }
+  if (print_allocations_)
+  {
+    std::cout << "Allocations: " << format_allocations (times.solving_allocations ()) \
+    << " while solving" << std::endl;
+    for (int p = 0; p < PhaseTimes::PHASE_COUNT; ++p)
+    {
+      std::cout << "  " << PhaseTimes::name (p) << ": " << \
+      format_allocations (times.allocations[p]) << std::endl;
+    }
+    std::cout << "Peak resident memory: " << AllocCounter::peak_rss () / 1024 << " KB" \
+    << std::endl;
+  }
+  if (print_time_)
+  {
+    std::cout << "Run time: " << format_seconds (seconds_since (begin)) << " s" << std::endl;
+    std::cout << "Time by phase:" << std::endl;
+    for (int p = 0; p < PhaseTimes::PHASE_COUNT; ++p)
+    {
+      std::cout << "  " << PhaseTimes::name (p) << ": " << format_seconds (times.seconds[p]) \
+      << " s" << std::endl;
+    }
+  }
+  report.set_wall_time (seconds_since (begin));
+  report.print (std::cout);
+  if (!report_file_.empty () && !report.write_json (report_file_))
+  {
+    std::cerr << "ERROR! Could not write report file." << std::endl;
+  }
+  if (restarts_.enabled () && technique_ <= DLX_TECH)
+  {
+    std::cout << "Restarts: " << restart_count << std::endl;
+  }
+  if (technique_ == CSP_TECH && table_.enabled ())
+  {
+    std::cout << "Transposition table: " << table_.hits () << " hit(s), " << table_.stores () \
+    << " dead state(s) stored" << std::endl;
+  }
+  if (technique_ == CSP_TECH && nogoods_.enabled ())
+  {
+    std::cout << "Nogoods: " << nogoods_.learned () << " learned, " << nogoods_.pruned () \
+    << " branch(es) pruned" << std::endl;
+  }
+  if (technique_ == CSP_TECH && csp_rules_.value_order != CSPRules::NATURAL)
+  {
+    std::cout << "Value order: " << CSPRules::order_name (csp_rules_.value_order) << std::endl;
+  }
+  if (technique_ == CSP_TECH && csp_rules_.level != CSPRules::SINGLES)
+  {
+    std::cout << "Rule firings:" << std::endl;
+    for (int r = 0; r < CSPRules::RULE_COUNT; ++r)
+    {
+      std::cout << "  " << CSPRules::name (r) << ": " << csp_rules_.fired[r] << std::endl;
+    }
+  }
+}
+
+void SudokuSolver::generate (const long count, const int clues, std::string outfile)
+{
+  const std::chrono::steady_clock::time_point then = std::chrono::steady_clock::now ();
+  std::vector <std::thread> workers;
+  GeneratorQueue queue;
+  std::ofstream out;
+  int threads = (threads_ > 0 ? threads_ : (int) std::thread::hardware_concurrency ());
+  double seconds = 0.0;
+
+  if (count <= 0)
+  {
+    std::cerr << "ERROR! Invalid number of puzzles to generate." << std::endl;
+    return;
+  }
+  out.open (outfile);
+  if (!out.is_open ())
+  {
+    std::cerr << "ERROR! Could not open output file." << std::endl;
+    return;
+  }
+  queue.chunks = (count + GENERATE_CHUNK - 1) / GENERATE_CHUNK;
+  threads = (int) std::max (1L, std::min ((long) threads, queue.chunks));
+  queue.next = 0;
+  queue.written = 0;
+  queue.window = (long) threads * GENERATE_AHEAD;
+  queue.above = 0;
+  queue.failed = false;
+  std::cout << "Generating " << count << " puzzle(s) of " << box_rows_ << "x" << box_cols_ \
+  << " boxes on " << threads << " thread(s)." << std::endl;
+  for (int t = 0; t < threads; ++t)
+  {
+    workers.push_back (std::thread (generate_chunks, &queue, box_rows_, box_cols_, seed_, count,
+      std::max (clues, 0)));
+  }
+  /// Write the chunks in order, as soon as each one is complete
+  for (long chunk = 0; chunk < queue.chunks; ++chunk)
+  {
+    std::string text;
+
+    {
+      std::unique_lock <std::mutex> guard (queue.lock);
+
+      queue.changed.wait (guard, [&queue, chunk] () {
+        return queue.failed || queue.done.count (chunk) != 0;
+      });
+      if (queue.failed)
+      {
+        break;
+      }
+      text.swap (queue.done[chunk]);
+      queue.done.erase (chunk);
+      ++queue.written;
+    }
+    queue.changed.notify_all ();
+    out << text;
+  }
+  for (unsigned int t = 0; t < workers.size (); ++t)
+  {
+    workers[t].join ();
+  }
+  out.close ();
+  if (queue.failed)
+  {
+    std::cerr << "ERROR! Could not generate a puzzle of the given box geometry." << std::endl;
+    return;
+  }
+  seconds = seconds_since (then);
+  std::cout << "Generated " << count << " puzzle(s) in " << seconds << " seconds (" \
+  << count / seconds << " puzzles/s)" << std::endl;
+  if (queue.above > 0)
+  {
+    std::cout << queue.above << " puzzle(s) have more than " << clues << " clues, the fewest " \
+    "found in " << GENERATE_ATTEMPTS << " attempts" << std::endl;
+  }
+}
+
+void SudokuSolver::set_threads (const int threads)
+{
+  threads_ = (threads > 0 ? threads : 0);
+}
+
+void SudokuSolver::solve_puzzle (Puzzle& puzzle)
+{
+  limits_.start ();
+  if (technique_ == CSP_TECH)
+  {
+    sovle_CSP (puzzle);
+  }
+  else if (technique_ == DLX_TECH || puzzle.grid_size () != 9)
+  {
+    /// The bitboard techniques only handle 9x9 puzzles
+    solve_EC (puzzle);
+  }
+  else if (technique_ == BIT_TECH)
+  {
+    solve_BIT (puzzle, bit_solver_);
+  }
+  else if (technique_ == SIMD_TECH)
+  {
+    solve_BIT (puzzle, simd_solver_);
+  }
+  /// Whatever the engines did not charge to an earlier phase went into the search
+  limits_.lap (PhaseTimes::SEARCH);
+  puzzle.times.clear_solving ();
+  puzzle.times.add (limits_.times ());
+  puzzle.proc_time = puzzle.times.solving ();
+  puzzle.outcome = outcome (puzzle);
 }
 
 void SudokuSolver::toggle_print_time (const bool flag)
@@ -104,14 +570,74 @@ void SudokuSolver::toggle_print_time (const bool flag)
   print_time_ = flag;
 }
 
+void SudokuSolver::set_report_file (const std::string& path)
+{
+  report_file_ = path;
+}
+
+void SudokuSolver::toggle_print_stats (const bool flag)
+{
+  print_stats_ = flag;
+}
+
+void SudokuSolver::toggle_alloc_stats (const bool flag)
+{
+  print_allocations_ = flag;
+  if (flag && !AllocCounter::hooked ())
+  {
+    std::cout << "WARNING! Allocations are not counted in this program. Resorting to peak " \
+    "memory only." << std::endl;
+  }
+  else if (flag)
+  {
+    AllocCounter::enable ();
+  }
+}
+
+void SudokuSolver::toggle_perf_counters (const bool flag)
+{
+  counters_.close ();
+  limits_.set_counters (NULL);
+  print_counters_ = false;
+  if (!flag)
+  {
+    return;
+  }
+  if (!counters_.open ())
+  {
+    std::cout << "WARNING! Hardware performance counters are not available. Resorting to wall " \
+    "time only." << std::endl;
+    return;
+  }
+  limits_.set_counters (&counters_);
+  print_counters_ = true;
+}
+
 void SudokuSolver::toggle_terminal_output (const bool flag)
 {
   display_ = flag;
 }
 
+void SudokuSolver::toggle_quiet (const bool flag)
+{
+  quiet_ = flag;
+  for (auto it = ec_solvers_.begin (); it != ec_solvers_.end (); ++it)
+  {
+    it->second.set_quiet (quiet_);
+  }
+  bit_solver_.set_quiet (quiet_);
+  simd_solver_.set_quiet (quiet_);
+  csp_rules_.quiet = quiet_;
+}
+
+void SudokuSolver::toggle_batch (const bool flag)
+{
+  batch_ = flag;
+}
+
 void SudokuSolver::set_technique (const int technique)
 {
-  if (technique != CSP_TECH && technique != DLX_TECH)
+  if (technique < CSP_TECH || technique > SIMD_TECH)
   {
     std::cout << "WARNING! Invalid technique code. Resorting to default technique." << std::endl;
     return;
@@ -121,7 +647,114 @@ void SudokuSolver::set_technique (const int technique)
 
 void SudokuSolver::set_grid_size (const int size)
 {
-  grid_size_ = size;
+  int box_rows = 0;
+  int box_cols = 0;
+
+  if (!ExactCoverSolver::box_dims (size, box_rows, box_cols))
+  {
+    std::cout << "WARNING! Unsupported grid size. Resorting to detecting it from the input." \
+    << std::endl;
+    return;
+  }
+  set_box_geometry (box_rows, box_cols);
+}
+
+void SudokuSolver::set_box_geometry (const int rows, const int cols)
+{
+  if (rows < 2 || cols < 2)
+  {
+    std::cout << "WARNING! Invalid box geometry. Resorting to detecting it from the input." \
+    << std::endl;
+    return;
+  }
+  box_rows_ = rows;
+  box_cols_ = cols;
+  auto_size_ = false;
+}
+
+void SudokuSolver::set_propagation_level (const int level)
+{
+  if (level < CSPRules::SINGLES || level > CSPRules::FISH)
+  {
+    std::cout << "WARNING! Invalid propagation level. Resorting to default level." << std::endl;
+    return;
+  }
+  csp_rules_.level = level;
+}
+
+void SudokuSolver::set_value_order (const int order)
+{
+  if (order < CSPRules::NATURAL || order > CSPRules::RANDOM)
+  {
+    std::cout << "WARNING! Invalid value order. Resorting to default order." << std::endl;
+    return;
+  }
+  csp_rules_.value_order = order;
+}
+
+void SudokuSolver::set_seed (const unsigned int seed)
+{
+  seed_ = seed;
+}
+
+void SudokuSolver::set_restarts (const int kind, const long base)
+{
+  if (kind < RestartSchedule::NONE || kind > RestartSchedule::GEOMETRIC)
+  {
+    std::cout << "WARNING! Invalid restart schedule. Resorting to a single run." << std::endl;
+    return;
+  }
+  restart_kind_ = kind;
+  restart_base_ = base;
+  restarts_.set (kind, base);
+}
+
+void SudokuSolver::set_table_size (const long bytes)
+{
+  /// Resizing empties the table, which is only done when the budget changes
+  if (bytes == table_bytes_)
+  {
+    return;
+  }
+  table_bytes_ = bytes;
+  table_.resize (bytes);
+  csp_rules_.table = (table_.enabled () ? &table_ : NULL);
+}
+
+void SudokuSolver::set_nogood_limits (const int max_count, const int max_length)
+{
+  nogood_count_ = max_count;
+  nogood_length_ = max_length;
+  nogoods_.set_limits (max_count, max_length);
+  csp_rules_.nogoods = (nogoods_.enabled () ? &nogoods_ : NULL);
+}
+
+void SudokuSolver::set_time_limit (const double seconds)
+{
+  time_limit_ = seconds;
+  limits_.set_time_limit (seconds);
+}
+
+void SudokuSolver::set_node_limit (const long nodes)
+{
+  node_limit_ = nodes;
+  limits_.set_node_limit (nodes);
+}
+
+void SudokuSolver::set_cancel_flag (const std::atomic<bool>* flag)
+{
+  limits_.set_cancel_flag (flag);
+}
+
+void SudokuSolver::set_solution_limit (const int limit)
+{
+  solution_limit_ = (limit > 0 ? limit : 1);
+  for (auto it = ec_solvers_.begin (); it != ec_solvers_.end (); ++it)
+  {
+    it->second.set_solution_limit (solution_limit_);
+  }
+  bit_solver_.set_solution_limit (solution_limit_);
+  simd_solver_.set_solution_limit (solution_limit_);
 }
 
 bool SudokuSolver::validate_input (const std::string& infile, std::vector <Puzzle>& puzzles)
@@ -131,12 +764,15 @@ bool SudokuSolver::validate_input (const std::string& infile, std::vector <Puzzl
   int count = 0;
   Puzzle curr_puzzle;
   std::vector <int> tmp_list;
+  std::chrono::steady_clock::time_point then;
+  AllocCounts allocated = AllocCounter::current ();
 
   if (infile.empty ())
   {
     std::cerr << "ERROR! Empty filename." << std::endl;
     return false;
   }
+  curr_puzzle.clear ();
 
   try
   {
@@ -152,14 +788,32 @@ bool SudokuSolver::validate_input (const std::string& infile, std::vector <Puzzl
       if (!line.empty () && !blank (line))
       {
         /// Completed a grid
-        if (count != 0 && count % grid_size_ == 0)
+        if (count != 0 && count == curr_puzzle.grid_size ())
         {
           curr_puzzle.solved = false;
           curr_puzzle.output_grid = curr_puzzle.input_grid;
+          curr_puzzle.index = puzzles.size () + 1;
+          curr_puzzle.times.seconds[PhaseTimes::PARSE] = seconds_since (then);
+          curr_puzzle.times.allocations[PhaseTimes::PARSE] = AllocCounter::since (allocated);
+          if (Trace::enabled ())
+          {
+            Trace::span ("parse", "phase", then, std::chrono::steady_clock::now (), \
+              curr_puzzle.index);
+          }
           puzzles.push_back (curr_puzzle);
           curr_puzzle.clear ();
           count = 0;
         }
+        if (count == 0)
+        {
+          then = std::chrono::steady_clock::now ();
+          allocated = AllocCounter::current ();
+        }
+        /// The grid size of a puzzle is given by the width of its first row
+        if (count == 0 && !detect_geometry (line, curr_puzzle))
+        {
+          return false;
+        }
         /// Validate line
         curr_puzzle.input_grid.push_back (tmp_list);
         if (!validate_line (line, curr_puzzle, count))
@@ -169,15 +823,22 @@ bool SudokuSolver::validate_input (const std::string& infile, std::vector <Puzzl
         ++count;
       }
     }
-    if (count % grid_size_ != 0)
+    if (count != 0 && count != curr_puzzle.grid_size ())
     {
       std::cerr << "ERROR! One or more incomplete puzzles in input file." << std::endl;
       return false;
     }
-    else if (count == grid_size_)
+    else if (count != 0)
     {
       curr_puzzle.solved = false;
       curr_puzzle.output_grid = curr_puzzle.input_grid;
+      curr_puzzle.index = puzzles.size () + 1;
+      curr_puzzle.times.seconds[PhaseTimes::PARSE] = seconds_since (then);
+      curr_puzzle.times.allocations[PhaseTimes::PARSE] = AllocCounter::since (allocated);
+      if (Trace::enabled ())
+      {
+        Trace::span ("parse", "phase", then, std::chrono::steady_clock::now (), curr_puzzle.index);
+      }
       puzzles.push_back (curr_puzzle);
     }
     return true;
@@ -213,7 +874,7 @@ bool SudokuSolver::validate_line (std::string& line, Puzzle& puzzle, const int c
     puzzle.input_grid[count].push_back (num);
     token = strtok (NULL, " ,;.");
   }
-  if ((int) puzzle.input_grid[count].size () != grid_size_)
+  if ((int) puzzle.input_grid[count].size () != puzzle.grid_size ())
   {
     std::cerr << "ERROR! One or more incomplete puzzles in file." << std::endl;
     return false;
@@ -222,6 +883,38 @@ bool SudokuSolver::validate_line (std::string& line, Puzzle& puzzle, const int c
   return true;
 }
 
+bool SudokuSolver::detect_geometry (const std::string& line, Puzzle& puzzle)
+{
+  const int width = row_width (line);
+
+  if (!auto_size_)
+  {
+    puzzle.box_rows = box_rows_;
+    puzzle.box_cols = box_cols_;
+  }
+  else if (!ExactCoverSolver::box_dims (width, puzzle.box_rows, puzzle.box_cols))
+  {
+    std::cerr << "ERROR! Unsupported grid size in input file: " << width << "." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+int SudokuSolver::row_width (const std::string& line)
+{
+  char tmp[line.size () + 1];
+  int width = 0;
+
+  strcpy (tmp, line.c_str ());
+  for (char* token = strtok (tmp, " ,;."); token != NULL; token = strtok (NULL, " ,;."))
+  {
+    ++width;
+  }
+
+  return width;
+}
+
 bool SudokuSolver::blank (const std::string& line)
 {
   for (unsigned int i = 0; i < line.size (); ++i)
@@ -237,46 +930,450 @@ bool SudokuSolver::blank (const std::string& line)
 
 void SudokuSolver::solve_EC (Puzzle& puzzle)
 {
-  struct timeval then;
-  struct timeval now;
+  ExactCoverSolver* ec_solver = dlx_solver (puzzle);
+
+  puzzle.technique = DLX_TECH;
+  if (ec_solver == NULL)
+  {
+    if (!quiet_)
+    {
+      std::cout << "ERROR! Could not initialize Sudoko DLX solver." << std::endl;
+    }
+    return;
+  }
+  restarts_.reset ();
+  rng_.seed (seed_);
+  for (int run = 0; run == 0 || limits_.cut_off (); ++run)
+  {
+    if (restarts_.enabled () && solution_limit_ == 1)
+    {
+      limits_.restart (restarts_.next ());
+    }
+    /// Runs after the first break ties at random to stray from the previous ones
+    ec_solver->set_random (run > 0 ? &rng_ : NULL);
+    ec_solver->solve (puzzle.input_grid, &limits_);
+    puzzle.restarts = run;
+  }
+  puzzle.nodes = limits_.nodes ();
+  puzzle.stats = limits_.stats ();
+  puzzle.solution_count = ec_solver->solution_count ();
+  puzzle.timed_out = ec_solver->is_timed_out ();
+  if (ec_solver->is_solved () && !puzzle.timed_out)
+  {
+    ec_solver->output (puzzle.output_grid);
+    puzzle.solved = true;
+  }
+  else
+  {
+    puzzle.solved = false;
+  }
+}
+
+ExactCoverSolver* SudokuSolver::dlx_solver (const Puzzle& puzzle)
+{
+  const std::pair <int, int> geometry (puzzle.box_rows, puzzle.box_cols);
+  auto it = ec_solvers_.find (geometry);
+
+  /// Solvers are built once per geometry and reused for every later puzzle of that size
+  if (it == ec_solvers_.end ())
+  {
+    it = ec_solvers_.insert (std::make_pair (geometry, ExactCoverSolver ())).first;
+    if (!it->second.init (puzzle.box_rows, puzzle.box_cols))
+    {
+      ec_solvers_.erase (it);
+      return NULL;
+    }
+    it->second.set_solution_limit (solution_limit_);
+    it->second.set_quiet (quiet_);
+  }
 
-  gettimeofday (&then, NULL);
-  ec_solver_.solve (puzzle.input_grid);
-  if (ec_solver_.is_solved ())
+  return &it->second;
+}
+
+void SudokuSolver::solve_BIT (Puzzle& puzzle, BitboardSolver& solver)
+{
+  puzzle.technique = (&solver == &simd_solver_ ? SIMD_TECH : BIT_TECH);
+  solver.solve (puzzle.input_grid, &limits_);
+  puzzle.nodes = limits_.nodes ();
+  puzzle.stats = limits_.stats ();
+  puzzle.solution_count = solver.solution_count ();
+  puzzle.timed_out = solver.is_timed_out ();
+  if (solver.is_solved () && !puzzle.timed_out)
   {
-    ec_solver_.output (puzzle.output_grid);
+    solver.output (puzzle.output_grid);
     puzzle.solved = true;
   }
   else
   {
     puzzle.solved = false;
   }
-  gettimeofday (&now, NULL);
-  puzzle.proc_time = (now.tv_sec - then.tv_sec + (1e-6 * (now.tv_usec - then.tv_usec)));
 }
 
-void SudokuSolver::sovle_CSP (Puzzle& puzzle) const
+void SudokuSolver::solve_library (Puzzle& puzzle)
+{
+  const int grid_size = puzzle.grid_size ();
+  std::vector <uint8_t> cells (grid_size * grid_size);
+  std::vector <uint8_t> solution (grid_size * grid_size);
+  sudoku::Options options;
+  sudoku::Stats stats;
+  int status = sudoku::INVALID_INPUT;
+
+  /// Values that do not fit in a cell are passed on as invalid ones
+  for (int k = 0; k < grid_size * grid_size; ++k)
+  {
+    const int val = puzzle.input_grid[k / grid_size][k % grid_size];
+
+    cells[k] = (uint8_t) (val < 0 || val > grid_size ? sudoku::MAX_GRID_SIZE + 1 : val);
+  }
+  options.technique = technique_;
+  options.box_rows = puzzle.box_rows;
+  options.box_cols = puzzle.box_cols;
+  options.level = csp_rules_.level;
+  options.value_order = csp_rules_.value_order;
+  options.seed = seed_;
+  /// The library takes no negative limits or sizes, they disable the limit just like zero
+  options.time_limit = std::max (time_limit_, 0.0);
+  options.node_limit = std::max (node_limit_, 0L);
+  options.solution_limit = solution_limit_;
+  options.restarts = restart_kind_;
+  options.restart_base = std::max (restart_base_, 1L);
+  options.table_bytes = std::max (table_bytes_, 0L);
+  options.nogoods = std::max (nogood_count_, 0);
+  options.nogood_length = std::max (nogood_length_, 0);
+  status = sudoku::solve (&cells[0], &solution[0], options, &stats);
+  if (status == sudoku::INVALID_INPUT)
+  {
+    if (!quiet_)
+    {
+      std::cout << "ERROR! Invalid puzzle specified." << std::endl;
+    }
+    puzzle.outcome = RunReport::NO_SOLUTION;
+    return;
+  }
+  puzzle.solved = (status == sudoku::SOLVED);
+  puzzle.timed_out = (status == sudoku::TIME_LIMIT || status == sudoku::NODE_LIMIT);
+  puzzle.solution_count = stats.solutions;
+  puzzle.nodes = stats.nodes;
+  puzzle.restarts = stats.restarts;
+  puzzle.stats.guesses = stats.guesses;
+  puzzle.stats.backtracks = stats.backtracks;
+  puzzle.stats.max_depth = stats.max_depth;
+  puzzle.stats.propagations = stats.propagations;
+  puzzle.stats.covers = stats.covers;
+  puzzle.stats.choices = stats.choices;
+  puzzle.technique = stats.technique;
+  puzzle.outcome = status;
+  if (puzzle.solved)
+  {
+    for (int k = 0; k < grid_size * grid_size; ++k)
+    {
+      puzzle.output_grid[k / grid_size][k % grid_size] = solution[k];
+    }
+  }
+  /// This solver did the work, so its limits hold the phase times, hardware events and
+  /// allocations of the puzzle
+  puzzle.times.clear_solving ();
+  puzzle.times.add (limits_.times ());
+  puzzle.proc_time = puzzle.times.solving ();
+  if (Trace::enabled ())
+  {
+    trace_puzzle (puzzle);
+  }
+}
+
+void SudokuSolver::solve_batch (std::vector <Puzzle>& puzzles, const int begin, const int count)
+{
+  const std::chrono::steady_clock::time_point then = std::chrono::steady_clock::now ();
+  std::vector <BitboardSolver::State> states (count);
+  std::unique_ptr <bool[]> loaded (new bool[count]);
+  std::unique_ptr <bool[]> valid (new bool[count]);
+  double share = 0.0;
+
+  /// Propagate the whole slice at once, sharing its cost evenly among its puzzles
+  for (int i = 0; i < count; ++i)
+  {
+    loaded[i] = BitboardSolver::load (puzzles[begin + i].input_grid, states[i], quiet_);
+    if (!loaded[i])
+    {
+      memset (&states[i], 0, sizeof (BitboardSolver::State));
+    }
+  }
+  simd_solver_.propagate_batch (&states[0], count, valid.get ());
+  share = seconds_since (then) / count;
+  if (Trace::enabled ())
+  {
+    Trace::span ("batch propagation", "phase", then, std::chrono::steady_clock::now (), \
+      puzzles[begin].index, NULL, NULL, "puzzles", count);
+  }
+  /// Finish each puzzle on its own, searching where propagation got stuck
+  for (int i = 0; i < count; ++i)
+  {
+    Puzzle& puzzle = puzzles[begin + i];
+
+    std::cout << "Solving puzzle: " << begin + i + 1 << std::endl;
+    /// Loading is part of the shared propagation, the puzzles are not set up one by one
+    puzzle.times.clear_solving ();
+    puzzle.times.seconds[PhaseTimes::PROPAGATE] = share;
+    puzzle.proc_time = share;
+    puzzle.technique = SIMD_TECH;
+    if (!loaded[i])
+    {
+      continue;
+    }
+    else if (!valid[i])
+    {
+      if (!quiet_)
+      {
+        std::cout << "Puzzle is not solvable." << std::endl;
+      }
+      continue;
+    }
+    limits_.start ();
+    simd_solver_.solve (states[i], &limits_);
+    puzzle.nodes = limits_.nodes ();
+    puzzle.stats = limits_.stats ();
+    puzzle.solution_count = simd_solver_.solution_count ();
+    puzzle.timed_out = simd_solver_.is_timed_out ();
+    if (simd_solver_.is_solved () && !puzzle.timed_out)
+    {
+      simd_solver_.output (puzzle.output_grid);
+      puzzle.solved = true;
+    }
+    limits_.lap (PhaseTimes::SEARCH);
+    puzzle.times.add (limits_.times ());
+    puzzle.proc_time = puzzle.times.solving ();
+    puzzle.outcome = outcome (puzzle);
+    if (Trace::enabled ())
+    {
+      trace_puzzle (puzzle);
+    }
+  }
+}
+
+void SudokuSolver::sovle_CSP (Puzzle& puzzle)
 {
-  struct timeval then;
-  struct timeval now;
+  if (puzzle.box_rows == 3 && puzzle.box_cols == 3)
+  {
+    solve_CSP_grid<3, 3> (puzzle);
+  }
+  else if (puzzle.box_rows == 2 && puzzle.box_cols == 5)
+  {
+    solve_CSP_grid<2, 5> (puzzle);
+  }
+  else if (puzzle.box_rows == 3 && puzzle.box_cols == 4)
+  {
+    solve_CSP_grid<3, 4> (puzzle);
+  }
+  else if (puzzle.box_rows == 4 && puzzle.box_cols == 4)
+  {
+    solve_CSP_grid<4, 4> (puzzle);
+  }
+  else if (puzzle.box_rows == 5 && puzzle.box_cols == 5)
+  {
+    solve_CSP_grid<5, 5> (puzzle);
+  }
+  else if (puzzle.box_rows == 6 && puzzle.box_cols == 6)
+  {
+    solve_CSP_grid<6, 6> (puzzle);
+  }
+  else
+  {
+    solve_EC (puzzle);
+  }
+}
+
+template <int BOX_ROWS, int BOX_COLS>
+void SudokuSolver::solve_CSP_grid (Puzzle& puzzle)
+{
+  typedef CSPSolver<BOX_ROWS, BOX_COLS> Solver;
+  std::unique_ptr<Solver> csp;
+  std::unique_ptr<Solver> root;
+  std::vector <int> path;
+  std::vector <char> conflict;
   
-  gettimeofday (&then, NULL);
-  if (auto csp = solve_csp_aux (std::unique_ptr<CSPSolver> (new CSPSolver(puzzle.input_grid))))
+  puzzle.technique = CSP_TECH;
+  restarts_.reset ();
+  nogoods_.forget ();
+  csp_rules_.rng.seed (seed_);
+  root.reset (new Solver (puzzle.input_grid, &csp_rules_));
+  limits_.lap (PhaseTimes::SETUP);
+  /// The clues only went through singles, apply the stronger rules before searching
+  if (root->is_valid () && !root->propagate ())
+  {
+    root.reset ();
+  }
+  else if (root->is_valid ())
+  {
+    /// Only the clues themselves are given, whatever they solve is propagated
+    limits_.stats ().propagations += root->solved () - puzzle.clues ();
+  }
+  limits_.lap (PhaseTimes::PROPAGATE);
+  if (solution_limit_ > 1)
+  {
+    /// Count solutions, keeping the first one for output
+    puzzle.solution_count = (root != nullptr ? count_csp_solutions (*root, solution_limit_, csp,
+      &limits_) : 0);
+    puzzle.nodes = limits_.nodes ();
+    puzzle.stats = limits_.stats ();
+  }
+  else
   {
-    if (!csp->is_valid ())
+    for (int run = 0; run == 0 || limits_.cut_off (); ++run)
+    {
+      if (restarts_.enabled ())
+      {
+        limits_.restart (restarts_.next ());
+      }
+      /// Runs after the first break ties at random to stray from the previous ones
+      csp_rules_.random_ties = (run > 0);
+      std::unique_ptr<Solver> start (restarts_.enabled () && root != nullptr ?
+        new Solver (*root) : root.release ());
+
+      /// Nogoods hold for the whole puzzle, so they carry over from one run to the next
+      csp = (nogoods_.enabled () ? solve_csp_learning (std::move (start), nogoods_, path, conflict,
+        &limits_) : solve_csp_aux (std::move (start), &limits_));
+      puzzle.restarts = run;
+    }
+    csp_rules_.random_ties = false;
+    puzzle.nodes = limits_.nodes ();
+    puzzle.stats = limits_.stats ();
+    if (csp != nullptr && !csp->is_valid ())
     {
       return;
     }
-    csp->output (puzzle.output_grid);
+    puzzle.solution_count = (csp != nullptr ? 1 : 0);
   }
-  else
+  if (limits_.expired ())
   {
-    std::cout << "ERROR! Could not initialize Sudoko CSP solver." << std::endl;
+    if (!quiet_)
+    {
+      std::cout << "Puzzle search exceeded its time or node limit." << std::endl;
+    }
+    puzzle.timed_out = true;
     return;
   }
-  gettimeofday (&now, NULL);
+  else if (csp == nullptr)
+  {
+    if (!quiet_)
+    {
+      std::cout << "Puzzle is not solvable." << std::endl;
+    }
+    return;
+  }
+  csp->output (puzzle.output_grid);
   puzzle.solved = true;
-  puzzle.proc_time = (now.tv_sec - then.tv_sec + (1e-6 * (now.tv_usec - then.tv_usec)));
+}
+
+void SudokuSolver::trace_puzzle (const Puzzle& puzzle)
+{
+  const char* engine = RunReport::technique_name (puzzle.technique);
+  std::chrono::steady_clock::time_point begin = limits_.started ();
+
+  /// The phases follow each other from the start of the puzzle, as the engines lapped them
+  for (int p = PhaseTimes::SETUP; p <= PhaseTimes::SEARCH; ++p)
+  {
+    const std::chrono::steady_clock::time_point end = begin + \
+    std::chrono::duration_cast<std::chrono::steady_clock::duration> (
+      std::chrono::duration<double> (limits_.times ().seconds[p]));
+
+    Trace::span (PhaseTimes::name (p), "phase", begin, end, puzzle.index, engine);
+    begin = end;
+  }
+  Trace::span ("puzzle", "puzzle", limits_.started (), begin, puzzle.index, engine, \
+    RunReport::outcome_name (puzzle.outcome), "nodes", puzzle.nodes);
+}
+
+int SudokuSolver::outcome (const Puzzle& puzzle) const
+{
+  if (puzzle.solved)
+  {
+    return RunReport::SOLVED;
+  }
+  else if (!puzzle.timed_out)
+  {
+    return RunReport::NO_SOLUTION;
+  }
+
+  return (limits_.out_of_nodes () ? RunReport::NODE_LIMIT : RunReport::TIME_LIMIT);
+}
+
+void SudokuSolver::output_solution_count (Puzzle& puzzle, std::ofstream& out)
+{
+  std::string result;
+
+  if (puzzle.solution_count == 0)
+  {
+    result = "none";
+  }
+  else if (puzzle.solution_count == 1)
+  {
+    result = "unique";
+  }
+  else if (puzzle.solution_count < solution_limit_)
+  {
+    result = "multiple (" + std::to_string (puzzle.solution_count) + ")";
+  }
+  else
+  {
+    result = "multiple (at least " + std::to_string (puzzle.solution_count) + ")";
+  }
+  out << "Solutions: " << result << "\n";
+  if (display_)
+  {
+    std::cout << "Solutions: " << result << std::endl;
+  }
+}
+
+void SudokuSolver::output_stats (Puzzle& puzzle, std::ofstream& out)
+{
+  std::string result;
+
+  result = "nodes " + std::to_string (puzzle.nodes) + ", guesses " + \
+  std::to_string (puzzle.stats.guesses) + ", backtracks " + \
+  std::to_string (puzzle.stats.backtracks) + ", maximum depth " + \
+  std::to_string (puzzle.stats.max_depth) + ", propagated cells " + \
+  std::to_string (puzzle.stats.propagations) + ", column covers " + \
+  std::to_string (puzzle.stats.covers) + ", branching choices " + \
+  std::to_string (puzzle.stats.choices);
+  out << "Search: " << result << "\n";
+  if (display_)
+  {
+    std::cout << "Search: " << result << std::endl;
+  }
+}
+
+void SudokuSolver::output_counters (Puzzle& puzzle, std::ofstream& out)
+{
+  std::string result = "Counters: " + format_counters (puzzle.times.solving_counters ()) + "\n";
+
+  for (int p = PhaseTimes::SETUP; p <= PhaseTimes::SEARCH; ++p)
+  {
+    result += "  " + std::string (PhaseTimes::name (p)) + ": " + \
+    format_counters (puzzle.times.counters[p]) + "\n";
+  }
+  out << result;
+  if (display_)
+  {
+    std::cout << result;
+  }
+}
+
+void SudokuSolver::output_allocations (Puzzle& puzzle, std::ofstream& out)
+{
+  std::string result = "Allocations: " + format_allocations (puzzle.times.solving_allocations ()) + \
+  " while solving;";
+
+  /// The output phase is still running
+  for (int p = PhaseTimes::PARSE; p < PhaseTimes::OUTPUT; ++p)
+  {
+    result += std::string (p == PhaseTimes::PARSE ? " " : ", ") + PhaseTimes::name (p) + " " + \
+    format_allocations (puzzle.times.allocations[p]);
+  }
+  out << result << "\n";
+  if (display_)
+  {
+    std::cout << result << std::endl;
+  }
 }
 
 void SudokuSolver::output_puzzle (Puzzle& puzzle, std::ofstream& out)
@@ -284,10 +1381,20 @@ void SudokuSolver::output_puzzle (Puzzle& puzzle, std::ofstream& out)
   /// Output execution time if option is selected
   if (print_time_)
   {
-    out << "Processing time: " << std::to_string (puzzle.proc_time) << " s" << "\n";
+    std::string phases = "Phases:";
+
+    /// The output phase is still running
+    for (int p = PhaseTimes::PARSE; p < PhaseTimes::OUTPUT; ++p)
+    {
+      phases += std::string (p == PhaseTimes::PARSE ? " " : ", ") + PhaseTimes::name (p) + " " + \
+      format_seconds (puzzle.times.seconds[p]) + " s";
+    }
+    out << "Processing time: " << format_seconds (puzzle.proc_time) << " s" << "\n";
+    out << phases << "\n";
     if (display_)
     {
-      std::cout << "Processing time: " << std::to_string (puzzle.proc_time) << " s" << "\n";
+      std::cout << "Processing time: " << format_seconds (puzzle.proc_time) << " s" << "\n";
+      std::cout << phases << "\n";
     }
   }
   for (unsigned int i = 0; i < puzzle.output_grid.size (); ++i)
@@ -12,8 +12,17 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <random>
 
 #include "exact_cover.hpp"
+#include "constraint_propagation.hpp"
+#include "bitboard_propagation.hpp"
+#include "search_limits.hpp"
+#include "transposition_table.hpp"
+#include "puzzle_generator.hpp"
+#include "run_report.hpp"
+#include "trace.hpp"
 
 struct Puzzle
 {
@@ -21,6 +30,43 @@ struct Puzzle
   std::vector <std::vector <int> > output_grid;
   double proc_time;
   bool solved;
+  bool timed_out;
+  int solution_count;
+  /// Search nodes visited while solving
+  long nodes;
+  /// Number of times the search was restarted
+  int restarts;
+  /// Effort spent on the puzzle beyond the node count
+  SearchStats stats;
+  /// Processing time of each phase, proc_time being the solving ones
+  PhaseTimes times;
+  /// Technique that handled the puzzle and how it ended, one of RunReport::Outcome
+  int technique;
+  int outcome;
+  /// Position in the input, from 1
+  int index;
+  int box_rows;
+  int box_cols;
+
+  int grid_size () const
+  {
+    return box_rows * box_cols;
+  }
+
+  int clues () const
+  {
+    int count = 0;
+
+    for (unsigned int i = 0; i < input_grid.size (); ++i)
+    {
+      for (unsigned int j = 0; j < input_grid[i].size (); ++j)
+      {
+        count += (input_grid[i][j] != 0);
+      }
+    }
+
+    return count;
+  }
 
   void clear ()
   {
@@ -28,6 +74,17 @@ struct Puzzle
     output_grid.clear ();
     proc_time = 0.0;
     solved = false;
+    timed_out = false;
+    solution_count = 0;
+    nodes = 0;
+    restarts = 0;
+    stats.clear ();
+    times.clear ();
+    technique = 0;
+    outcome = RunReport::NO_SOLUTION;
+    index = 0;
+    box_rows = 0;
+    box_cols = 0;
   }
 };
 
@@ -58,37 +115,224 @@ public:
    */
   void solve (std::string infile, std::string outfile = "sudoku_output.txt");
 
+  /*! \brief Solves a single puzzle using the selected technique. Puzzles are never batched.
+   * 
+   * \param puzzle Puzzle with its input grid and box geometry set.
+   */
+  void solve_puzzle (Puzzle& puzzle);
+
+  /*! \brief Generates puzzles with a unique solution in the configured box geometry and writes
+   * them in the input format. Puzzles are generated in parallel and written in order as they
+   * complete; each one is derived from the seed and its position only, so the output does not
+   * depend on the number of threads.
+   * 
+   * \param count Number of puzzles of type long.
+   * \param clues Target number of clues. Zero makes every puzzle minimal, i.e. no clue can be
+   * taken away without losing uniqueness.
+   * \param outfile Output file of type string.
+   */
+  void generate (const long count, const int clues,
+    std::string outfile = "sudoku_puzzles.txt");
+
+  /*! \brief Set the number of threads used to generate puzzles.
+   * 
+   * \param threads Thread count. Zero uses every available core.
+   */
+  void set_threads (const int threads);
+
   /*! \brief Enable/disable record of processing time.
    * 
    * \param flag Toggle flag.
    */
   void toggle_print_time (const bool flag);
 
+  /*! \brief Enable/disable record of search statistics: guesses, backtracks, maximum depth,
+   * propagated cells, column covers and branching choices, per puzzle and for the whole run.
+   * 
+   * \param flag Toggle flag.
+   */
+  void toggle_print_stats (const bool flag);
+
+  /*! \brief Set the file the run summary is written to as JSON, along with the latency
+   * histograms. The summary is printed at the end of every run either way.
+   * 
+   * \param path Report file. Empty disables the JSON report.
+   */
+  void set_report_file (const std::string& path);
+
+  /*! \brief Enable/disable allocation accounting: allocations and bytes allocated through
+   * operator new in each phase, per puzzle and for the whole run, and the peak resident memory of
+   * the process. Allocations are only counted in programs that link in the allocation hooks, such
+   * as the command-line tool, and only in the thread that solves.
+   * 
+   * \param flag Toggle flag.
+   */
+  void toggle_alloc_stats (const bool flag);
+
+  /*! \brief Enable/disable hardware performance counters: cycles, instructions, cache misses
+   * and branch misses of the setup, propagation and search phases, per puzzle and for the whole
+   * run. The counters only count the calling thread, which must be the one that solves. If they
+   * are not available the solver carries on without them.
+   * 
+   * \param flag Toggle flag.
+   */
+  void toggle_perf_counters (const bool flag);
+
   /*! \brief Enable/disable terminal output.
    * 
    * \param flag Toggle flag.
    */
   void toggle_terminal_output (const bool flag);
 
+  /*! \brief Enable/disable quiet solving: invalid, unsolvable and timed out puzzles are no longer
+   * reported on the console while they are solved. Configuration warnings still are.
+   * 
+   * \param flag Toggle flag.
+   */
+  void toggle_quiet (const bool flag);
+
+  /*! \brief Enable/disable batch propagation. Only applies to the vectorized bitboard technique,
+   * which then propagates several puzzles at once, one per vector lane.
+   * 
+   * \param flag Toggle flag.
+   */
+  void toggle_batch (const bool flag);
+
   /*! \brief Set sudoku solving technique.
    * 
    * \param technique Technique ID of type int.
    */
   void set_technique (const int technique);
 
-  /*! \brief Set puzzle grid size.
+  /*! \brief Set puzzle grid size, using its default box geometry. By default the grid size is
+   * detected from the width of the first row of each puzzle, so a file may mix grid sizes.
    * 
    * \param size Puzzle size of type int.
    */
   void set_grid_size (const int size);
 
+  /*! \brief Set the box geometry of the puzzles. The grid is rows * cols cells wide.
+   * 
+   * \param rows Height of a box of type int.
+   * \param cols Width of a box of type int.
+   */
+  void set_box_geometry (const int rows, const int cols);
+
+  /*! \brief Set the propagation level of the CSP technique. Levels above naked and hidden
+   * singles spend more time per search node in exchange for a smaller search tree.
+   * 
+   * \param level Level of type int, one of CSPRules::Level.
+   */
+  void set_propagation_level (const int level);
+
+  /*! \brief Set the order in which the CSP technique tries the values of a branching cell.
+   * 
+   * \param order Value order of type int, one of CSPRules::ValueOrder.
+   */
+  void set_value_order (const int order);
+
+  /*! \brief Set the seed of the randomized parts of the search. Every puzzle starts from this
+   * seed, so runs are reproducible whatever the order of the puzzles.
+   * 
+   * \param seed Seed of type unsigned int.
+   */
+  void set_seed (const unsigned int seed);
+
+  /*! \brief Set the restart schedule of techniques 1 and 2. A puzzle that is not solved within
+   * the node budget of a run is searched again from scratch, breaking ties between branching
+   * choices at random, with the budget growing from run to run. Solution counting always
+   * searches in a single run.
+   * 
+   * \param kind Schedule kind of type int, one of RestartSchedule::Kind.
+   * \param base Node budget of the first run of type long.
+   */
+  void set_restarts (const int kind, const long base);
+
+  /*! \brief Set the memory budget of the transposition table of technique 1. The table records
+   * search states found to lead nowhere, so that the search skips them when it meets them again,
+   * e.g. after a restart. It is kept across the puzzles of an input file, and across later calls
+   * with the same budget.
+   * 
+   * \param bytes Memory budget in bytes. Zero disables the table.
+   */
+  void set_table_size (const long bytes);
+
+  /*! \brief Set the limits of the nogood store of technique 1, enabling its learning mode. Failed
+   * branches are then traced back to the decisions responsible, which are stored as nogoods and
+   * let the search jump back past the decisions that played no part. Solution counting does not
+   * learn.
+   * 
+   * \param max_count Maximum number of nogoods. Zero disables learning.
+   * \param max_length Maximum number of decisions in a nogood.
+   */
+  void set_nogood_limits (const int max_count, const int max_length);
+
+  /*! \brief Set the wall-time limit of a single puzzle.
+   * 
+   * \param seconds Time limit in seconds. Zero disables the limit.
+   */
+  void set_time_limit (const double seconds);
+
+  /*! \brief Set the maximum number of search nodes of a single puzzle.
+   * 
+   * \param nodes Node limit. Zero disables the limit.
+   */
+  void set_node_limit (const long nodes);
+
+  /*! \brief Set a flag that cancels the search of the current puzzle once raised, from any thread.
+   * It is polled along with the clock, and the puzzle ends as if its time limit was reached.
+   * 
+   * \param flag Pointer to cancellation flag. NULL disables cancellation.
+   */
+  void set_cancel_flag (const std::atomic<bool>* flag);
+
+  /*! \brief Set the number of solutions to look for per puzzle. A limit above 1 enables
+   * solution counting, and 2 is enough to tell unique puzzles from ambiguous ones.
+   * 
+   * \param limit Solution limit.
+   */
+  void set_solution_limit (const int limit);
+
 private:
+  friend struct MicroBench;
+
   bool print_time_;
+  bool print_stats_;
+  bool print_counters_;
+  bool print_allocations_;
   int technique_;
-  int grid_size_;
+  int box_rows_;
+  int box_cols_;
+  bool auto_size_;
+  int solution_limit_;
+  /// Limits of a single puzzle, passed on to the library interface along with the other settings
+  double time_limit_;
+  long node_limit_;
+  /// Settings of the restart schedule, transposition table and nogood store, kept for the same
+  /// reason
+  int restart_kind_;
+  long restart_base_;
+  long table_bytes_;
+  int nogood_count_;
+  int nogood_length_;
   bool ready_;
   bool display_;
-  ExactCoverSolver ec_solver_;
+  bool quiet_;
+  bool batch_;
+  unsigned int seed_;
+  int threads_;
+  std::string report_file_;
+  std::map <std::pair <int, int>, ExactCoverSolver> ec_solvers_;
+  BitboardSolver bit_solver_;
+  BitboardSolver simd_solver_;
+  SearchLimits limits_;
+  PerfCounters counters_;
+  RestartSchedule restarts_;
+  /// Source of random tie-breaking for the DLX technique, seeded once per puzzle
+  std::mt19937 rng_;
+  CSPRules csp_rules_;
+  TranspositionTable table_;
+  NogoodStore nogoods_;
 
   /*! \brief Validates input.
    * 
@@ -109,6 +353,24 @@ private:
    */
   bool validate_line (std::string& line, Puzzle& puzzle, const int count);
 
+  /*! \brief Sets the box geometry of a puzzle, either the configured one or the default one of
+   * the width of its first row.
+   *
+   * \param line First input line of the puzzle.
+   * \param puzzle Puzzle.
+   *
+   * \return false if the width is not a supported grid size, true otherwise.
+   */
+  bool detect_geometry (const std::string& line, Puzzle& puzzle);
+
+  /*! \brief Returns the number of values in an input line.
+   *
+   * \param line Input line of type string.
+   *
+   * \return Number of values of type int.
+   */
+  int row_width (const std::string& line);
+
   /*! \brief Checks if input line contains characters other than whitespaces.
    *
    * \return true if line is composed of one or more whitespaces, false otherwise.
@@ -121,11 +383,93 @@ private:
    */
   void solve_EC (Puzzle& puzzle);
 
-  /*! \brief Solves a puzzle using CSP.
+  /*! \brief Returns the DLX solver of the puzzle's box geometry, building it on first use.
+   * 
+   * \param puzzle Puzzle to solve.
+   *
+   * \return Pointer to solver or NULL if it could not be built.
+   */
+  ExactCoverSolver* dlx_solver (const Puzzle& puzzle);
+
+  /*! \brief Solves a puzzle using bitboard constraint propagation.
+   * 
+   * \param puzzle Input puzzle.
+   * \param solver Bitboard solver, using either the scalar or the vectorized kernel.
+   */
+  void solve_BIT (Puzzle& puzzle, BitboardSolver& solver);
+
+  /*! \brief Solves a puzzle through the library interface, sudoku::solve (), with this solver
+   * bound to the calling thread, then fills in the puzzle from the results.
    * 
    * \param puzzle Input puzzle.
    */
-  void sovle_CSP (Puzzle& puzzle) const;
+  void solve_library (Puzzle& puzzle);
+
+  /*! \brief Solves a slice of puzzles using batch propagation followed by the vectorized bitboard
+   * technique for the puzzles that need branching.
+   * 
+   * \param puzzles List of puzzles.
+   * \param begin Index of first puzzle of the slice.
+   * \param count Number of puzzles in the slice, at most the batch width.
+   */
+  void solve_batch (std::vector <Puzzle>& puzzles, const int begin, const int count);
+
+  /*! \brief Solves a puzzle using CSP, picking the solver instantiation that matches the box
+   * geometry. Falls back to Algorithm X for geometries without one.
+   * 
+   * \param puzzle Input puzzle.
+   */
+  void sovle_CSP (Puzzle& puzzle);
+
+  /*! \brief Solves a puzzle using CSP on a grid made of BOX_ROWS x BOX_COLS boxes.
+   * 
+   * \param puzzle Input puzzle.
+   */
+  template <int BOX_ROWS, int BOX_COLS>
+  void solve_CSP_grid (Puzzle& puzzle);
+
+  /*! \brief Returns how a puzzle ended, right after it was searched.
+   * 
+   * \param puzzle Examined puzzle.
+   *
+   * \return Outcome of type int, one of RunReport::Outcome.
+   */
+  int outcome (const Puzzle& puzzle) const;
+
+  /*! \brief Records the spans of a puzzle that was just searched: the puzzle itself and its
+   * setup, propagation and search phases.
+   * 
+   * \param puzzle Examined puzzle.
+   */
+  void trace_puzzle (const Puzzle& puzzle);
+
+  /*! \brief Outputs the number of solutions of a puzzle as unique, multiple or none.
+   * 
+   * \param puzzle Examined puzzle.
+   * \param out Output stream.
+   */
+  void output_solution_count (Puzzle& puzzle, std::ofstream& out);
+
+  /*! \brief Outputs the search statistics of a puzzle.
+   * 
+   * \param puzzle Examined puzzle.
+   * \param out Output stream.
+   */
+  void output_stats (Puzzle& puzzle, std::ofstream& out);
+
+  /*! \brief Outputs the hardware events of a puzzle, in total and by phase.
+   * 
+   * \param puzzle Examined puzzle.
+   * \param out Output stream.
+   */
+  void output_counters (Puzzle& puzzle, std::ofstream& out);
+
+  /*! \brief Outputs the allocations of a puzzle, in total and by phase.
+   * 
+   * \param puzzle Examined puzzle.
+   * \param out Output stream.
+   */
+  void output_allocations (Puzzle& puzzle, std::ofstream& out);
 
   /*! \brief Outputs a solved puzzle.
    * 
@@ -135,4 +479,26 @@ private:
   void output_puzzle (Puzzle& puzzle, std::ofstream& out);
 };
 
+//==================================================================================================
+//==================================================================================================
+
+/*! \brief Makes a solver the one sudoku::solve () works with on the calling thread, for as long as
+ * the binding lives. The command-line tool passes every setting through sudoku::Options, and only
+ * binds its solver so that the phase times, hardware events, allocations and table and nogood
+ * totals of its runs are collected on it.
+ */
+class SolverBinding
+{
+public:
+  explicit SolverBinding (SudokuSolver& solver);
+
+  ~SolverBinding ();
+
+private:
+  SudokuSolver* previous_;
+
+  SolverBinding (const SolverBinding&);
+  SolverBinding& operator= (const SolverBinding&);
+};
+
 #endif /// SUDOKU_SOLVER_HPP
@@ -0,0 +1,144 @@
+/*
+ * File:   trace.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ */
+
+#include <stdio.h>
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <iostream>
+
+#include "trace.hpp"
+
+/// A recorded span, timed in nanoseconds since tracing was enabled
+struct TraceSpan
+{
+  const char* name;
+  const char* category;
+  long begin;
+  long end;
+  long id;
+  const char* engine;
+  const char* outcome;
+  const char* count_name;
+  long count;
+};
+
+/// Spans of a single thread, the oldest ones are overwritten once it is full
+struct TraceRing
+{
+  std::vector <TraceSpan> spans;
+  /// Spans recorded so far, including the overwritten ones
+  long recorded;
+  int thread;
+};
+
+bool Trace::enabled_ = false;
+
+static long capacity_ = Trace::DEFAULT_CAPACITY;
+static std::chrono::steady_clock::time_point origin_;
+/// Every ring ever handed out, they outlive their threads so that they can be written at the end
+static std::mutex rings_lock_;
+static std::vector <std::unique_ptr <TraceRing> > rings_;
+static thread_local TraceRing* ring_ = NULL;
+
+void Trace::enable (const long capacity)
+{
+  capacity_ = (capacity > 0 ? capacity : DEFAULT_CAPACITY);
+  origin_ = std::chrono::steady_clock::now ();
+  enabled_ = true;
+}
+
+void Trace::record (const char* name, const char* category,
+  const std::chrono::steady_clock::time_point& begin,
+  const std::chrono::steady_clock::time_point& end, const long id, const char* engine,
+  const char* outcome, const char* count_name, const long count)
+{
+  /// The lock is only taken by the first span of each thread
+  if (ring_ == NULL)
+  {
+    std::lock_guard <std::mutex> guard (rings_lock_);
+
+    rings_.push_back (std::unique_ptr <TraceRing> (new TraceRing));
+    ring_ = rings_.back ().get ();
+    ring_->spans.resize (capacity_);
+    ring_->recorded = 0;
+    ring_->thread = rings_.size ();
+  }
+  TraceSpan& span = ring_->spans[ring_->recorded % capacity_];
+
+  span.name = name;
+  span.category = category;
+  span.begin = std::chrono::duration_cast<std::chrono::nanoseconds> (begin - origin_).count ();
+  span.end = std::chrono::duration_cast<std::chrono::nanoseconds> (end - origin_).count ();
+  span.id = id;
+  span.engine = engine;
+  span.outcome = outcome;
+  span.count_name = count_name;
+  span.count = count;
+  ++ring_->recorded;
+}
+
+bool Trace::write (const std::string& path)
+{
+  std::lock_guard <std::mutex> guard (rings_lock_);
+  FILE* out = fopen (path.c_str (), "w");
+  long dropped = 0;
+  bool first = true;
+
+  if (out == NULL)
+  {
+    return false;
+  }
+  fprintf (out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  for (unsigned int r = 0; r < rings_.size (); ++r)
+  {
+    const TraceRing& ring = *rings_[r];
+    const long kept = std::min (ring.recorded, capacity_);
+
+    fprintf (out, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, " \
+      "\"args\": {\"name\": \"thread %d\"}}", (first ? "" : ","), ring.thread, ring.thread);
+    first = false;
+    dropped += ring.recorded - kept;
+    /// Oldest span first
+    for (long k = ring.recorded - kept; k < ring.recorded; ++k)
+    {
+      const TraceSpan& span = ring.spans[k % capacity_];
+
+      fprintf (out, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, " \
+        "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {", span.name, span.category, \
+        ring.thread, span.begin / 1e3, (span.end - span.begin) / 1e3);
+      fprintf (out, "\"thread\": %d", ring.thread);
+      if (span.id >= 0)
+      {
+        fprintf (out, ", \"id\": %ld", span.id);
+      }
+      if (span.engine != NULL)
+      {
+        fprintf (out, ", \"engine\": \"%s\"", span.engine);
+      }
+      if (span.outcome != NULL)
+      {
+        fprintf (out, ", \"outcome\": \"%s\"", span.outcome);
+      }
+      if (span.count_name != NULL)
+      {
+        fprintf (out, ", \"%s\": %ld", span.count_name, span.count);
+      }
+      fprintf (out, "}}");
+    }
+  }
+  fprintf (out, "\n]}\n");
+  if (dropped > 0)
+  {
+    std::cout << "WARNING! Trace buffers were full, " << dropped << " oldest span(s) dropped." \
+    << std::endl;
+  }
+
+  return fclose (out) == 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * File:   trace.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Timeline of a run in the Chrome trace event format, which chrome://tracing and Perfetto load.
+ * Spans are recorded into a ring buffer per thread, so recording never takes a lock, and a full
+ * buffer drops its oldest spans. The buffers are dumped once the run is over and every thread that
+ * recorded has been joined.
+ *
+ * Tracing is off by default. Every recording call then costs a single test of a flag that never
+ * changes during the run.
+ */
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <string>
+
+class Trace
+{
+public:
+  /// Spans kept per thread by default, about 2 MB
+  static const long DEFAULT_CAPACITY = 1L << 15;
+
+  /*! \brief Enables tracing. Must be called before any thread records a span.
+   *
+   * \param capacity Spans kept per thread of type long.
+   */
+  static void enable (const long capacity = DEFAULT_CAPACITY);
+
+  /*! \brief Returns whether tracing is enabled.
+   *
+   * \return Status of type bool.
+   */
+  static inline bool enabled ()
+  {
+    return enabled_;
+  }
+
+  /*! \brief Records a span of the calling thread. Names and details must be string literals or
+   * otherwise outlive the trace.
+   *
+   * \param name Name of the span.
+   * \param category Category of the span, e.g. puzzle or phase.
+   * \param begin Start of the span.
+   * \param end End of the span.
+   * \param id Puzzle or chunk number, negative for none.
+   * \param engine Technique that handled the puzzle, NULL for none.
+   * \param outcome How the puzzle ended, NULL for none.
+   * \param count_name Name of the count, NULL for none.
+   * \param count Count, e.g. search nodes.
+   */
+  static inline void span (const char* name, const char* category,
+    const std::chrono::steady_clock::time_point& begin,
+    const std::chrono::steady_clock::time_point& end, const long id = -1,
+    const char* engine = NULL, const char* outcome = NULL, const char* count_name = NULL,
+    const long count = 0)
+  {
+    if (enabled_)
+    {
+      record (name, category, begin, end, id, engine, outcome, count_name, count);
+    }
+  }
+
+  /*! \brief Writes the spans of every thread as a Chrome trace JSON document.
+   *
+   * \param path Output file.
+   *
+   * \return false if the file could not be written, true otherwise.
+   */
+  static bool write (const std::string& path);
+
+private:
+  static bool enabled_;
+
+  /*! \brief Records a span into the ring buffer of the calling thread.
+   */
+  static void record (const char* name, const char* category,
+    const std::chrono::steady_clock::time_point& begin,
+    const std::chrono::steady_clock::time_point& end, const long id, const char* engine,
+    const char* outcome, const char* count_name, const long count);
+};
+
+#endif /// TRACE_HPP
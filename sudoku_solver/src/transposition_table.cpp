@@ -0,0 +1,61 @@
+/*
+ * File:   transposition_table.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ */
+
+#include <algorithm>
+
+#include "transposition_table.hpp"
+
+TranspositionTable::TranspositionTable ():
+  keys_ (1, 0),
+  mask_ (0),
+  hits_ (0),
+  stores_ (0)
+{}
+
+void TranspositionTable::resize (const long bytes)
+{
+  uint64_t entries = 1;
+
+  if (bytes < (long) (2 * sizeof (uint64_t)))
+  {
+    keys_.assign (1, 0);
+    mask_ = 0;
+    clear ();
+    return;
+  }
+  while (entries * 2 * sizeof (uint64_t) <= (uint64_t) bytes)
+  {
+    entries *= 2;
+  }
+  keys_.assign (entries, 0);
+  keys_.shrink_to_fit ();
+  mask_ = entries - 1;
+  clear ();
+}
+
+bool TranspositionTable::enabled () const
+{
+  return keys_.size () > 1;
+}
+
+void TranspositionTable::clear ()
+{
+  std::fill (keys_.begin (), keys_.end (), 0);
+  hits_ = 0;
+  stores_ = 0;
+}
+
+long TranspositionTable::hits () const
+{
+  return hits_;
+}
+
+long TranspositionTable::stores () const
+{
+  return stores_;
+}
@@ -0,0 +1,100 @@
+/*
+ * File:   transposition_table.hpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Table of search states known to lead nowhere, identified by their Zobrist hash. A state is only
+ * known by its 64-bit hash, so a collision may in theory prune a live state; with a table of a few
+ * million entries the odds of that are negligible.
+ */
+
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include <vector>
+#include <stdint.h>
+
+class TranspositionTable
+{
+public:
+  /*! \brief Constructor of TranspositionTable. The table is disabled until it is given memory.
+   */
+  TranspositionTable ();
+
+  /*! \brief Sets the memory budget of the table and empties it. The table holds the largest
+   * power of two of entries that fits in the budget.
+   *
+   * \param bytes Memory budget in bytes of type long. Zero or less disables the table.
+   */
+  void resize (const long bytes);
+
+  /*! \brief Returns whether the table has been given memory.
+   *
+   * \return Status of type bool.
+   */
+  bool enabled () const;
+
+  /*! \brief Forgets every stored state and resets the counters.
+   */
+  void clear ();
+
+  /*! \brief Returns whether a state is known to lead nowhere.
+   *
+   * \param key Zobrist hash of the state.
+   *
+   * \return Status of type bool.
+   */
+  inline bool contains (const uint64_t key)
+  {
+    if (keys_[index (key)] == tag (key))
+    {
+      ++hits_;
+      return true;
+    }
+
+    return false;
+  }
+
+  /*! \brief Records a state that leads nowhere, replacing whatever state shared its entry.
+   *
+   * \param key Zobrist hash of the state.
+   */
+  inline void store (const uint64_t key)
+  {
+    keys_[index (key)] = tag (key);
+    ++stores_;
+  }
+
+  /*! \brief Returns the number of states found in the table since the last clear.
+   *
+   * \return Hit count of type long.
+   */
+  long hits () const;
+
+  /*! \brief Returns the number of states stored since the last clear.
+   *
+   * \return Store count of type long.
+   */
+  long stores () const;
+
+private:
+  std::vector <uint64_t> keys_;
+  uint64_t mask_;
+  long hits_;
+  long stores_;
+
+  inline uint64_t index (const uint64_t key) const
+  {
+    return key & mask_;
+  }
+
+  /// Empty entries hold 0, so no stored key may be 0
+  inline uint64_t tag (const uint64_t key) const
+  {
+    return (key != 0 ? key : 1);
+  }
+};
+
+#endif /// TRANSPOSITION_TABLE_HPP
@@ -0,0 +1,504 @@
+/*
+ * File:   cross_check.cpp
+ *
+ * This file is part of SudokuSolver.
+ *
+ * Author: Michael Morckos <mikey.morckos@gmail.com>
+ *
+ * Cross-check of the bitboard propagation kernels against the CSP and DLX engines. A seeded corpus
+ * of unique 9x9 puzzles is generated, and each of them is turned into an unsolvable one by adding a
+ * clue that does not match its solution. Every puzzle is solved by the CSP and DLX engines, by the
+ * scalar, portable, SSE2 and AVX2 kernels and, a slice of puzzles at a time, by every batch kernel.
+ * All of them must agree on whether the puzzle is solvable and on its solution. Kernels the host
+ * CPU does not support are skipped. The forced moves of the DLX engine must also leave no column of
+ * a single row or of none behind, and a cancellation flag must stop a search of every technique.
+ *
+ * Usage: SudokuCheck [-n <count>] [-s <seed>]
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "src/sudoku.hpp"
+#include "src/sudoku_solver.hpp"
+#include "src/puzzle_generator.hpp"
+#include "src/bitboard_batch.hpp"
+
+typedef std::vector <std::vector <int> > Grid;
+
+/// Well known hard 9x9 puzzles
+static const char* CLASSICS[] = {
+  "4.....8.5.3..........7......2.....6.....8.4......1.......6.3.7.5..2.....1.4......",
+  "8..........36......7..9.2...5...7.......457.....1...3...1....68..85...1..9....4..",
+  "1....7.9..3..2...8..96..5....53..9...1..8...26....4...3......1..4......7..7...3..",
+  ".......39.....1..5..3.5.8....8.9...6.7...2...1..4.......9.8..5..2....6..4..7....."};
+static const int CLASSIC_COUNT = sizeof (CLASSICS) / sizeof (CLASSICS[0]);
+
+/// Puzzles that once broke an engine. The first one left a contradictory lane of the batch
+/// kernels with pending singles, which kept the kernel looping forever.
+static const char* REGRESSIONS[] = {
+  "12345678....................................9...........................23456789."};
+static const int REGRESSION_COUNT = sizeof (REGRESSIONS) / sizeof (REGRESSIONS[0]);
+
+/// Target clue counts of the generated puzzles, zero for minimal ones
+static const int CLUES[] = {36, 30, 0};
+static const int CLUE_TIERS = sizeof (CLUES) / sizeof (CLUES[0]);
+
+struct Case
+{
+  Grid input;
+  /// Outcome of the CSP engine, which every other engine must match
+  bool solved;
+  Grid solution;
+};
+
+/// Reaches the kernel selection of the bitboard solver and the forced moves of the DLX solver
+struct CrossCheck
+{
+  static void use_kernel (BitboardSolver& solver, BitboardSolver::Kernel kernel,
+    const char* name)
+  {
+    solver.propagate_ = (kernel != NULL ? kernel : &BitboardSolver::propagate);
+    solver.kernel_name_ = name;
+  }
+
+  static void use_batch_kernel (BitboardSolver& solver, BitboardSolver::BatchKernel kernel,
+    const int width)
+  {
+    solver.propagate_batch_ = kernel;
+    solver.batch_width_ = width;
+  }
+
+  /*! \brief Loads the clues of a puzzle into the DLX solver and commits its forced moves, then
+   * checks that they left no column of size 0 or 1 behind. The solver is restored afterwards.
+   *
+   * \return false if a forced move or a dead end was missed, true otherwise.
+   */
+  static bool force_to_fixpoint (ExactCoverSolver& solver, const Grid& input)
+  {
+    std::vector <int> clues;
+    bool complete = true;
+    int forced = 0;
+
+    for (int k = 0; k < 81; ++k)
+    {
+      const int v = input[k / 9][k % 9];
+      const int row = (v != 0 ? solver.find (k / 9, k % 9, v - 1) : -1);
+
+      if (row != -1)
+      {
+        commit (solver, row);
+        clues.push_back (row);
+      }
+    }
+    if (solver.force (forced))
+    {
+      for (int col = solver.nodes_[ExactCoverSolver::ROOT].right_; col != ExactCoverSolver::ROOT;
+        col = solver.nodes_[col].right_)
+      {
+        complete = complete && solver.col_size_[col] > 1;
+      }
+    }
+    solver.unforce (forced);
+    for (; !clues.empty (); clues.pop_back ())
+    {
+      const int row = clues.back ();
+
+      for (int node = solver.nodes_[row].left_; node != row; node = solver.nodes_[node].left_)
+      {
+        solver.uncover (solver.nodes_[node].col_header_);
+      }
+      solver.uncover (solver.nodes_[row].col_header_);
+    }
+
+    return complete;
+  }
+
+  /// Covers a row and every column it intersects, the way a clue is loaded
+  static void commit (ExactCoverSolver& solver, const int row)
+  {
+    solver.cover (solver.nodes_[row].col_header_);
+    for (int node = solver.nodes_[row].right_; node != row; node = solver.nodes_[node].right_)
+    {
+      solver.cover (solver.nodes_[node].col_header_);
+    }
+  }
+};
+
+/*! \brief Solves a puzzle with one of the techniques of the command-line tool.
+ *
+ * \param solver Solver set up with the technique.
+ * \param input Puzzle.
+ * \param solution Receives the solution, if any.
+ *
+ * \return Whether the puzzle was solved.
+ */
+static bool solve (SudokuSolver& solver, const Grid& input, Grid& solution)
+{
+  Puzzle puzzle;
+
+  puzzle.clear ();
+  puzzle.input_grid = input;
+  puzzle.output_grid = input;
+  puzzle.box_rows = 3;
+  puzzle.box_cols = 3;
+  solver.solve_puzzle (puzzle);
+  solution = puzzle.output_grid;
+
+  return puzzle.solved;
+}
+
+/*! \brief Compares the outcome of an engine with the reference one and reports any mismatch.
+ *
+ * \param engine Name of the engine.
+ * \param index Position of the puzzle in the corpus, from 1.
+ * \param reference Reference outcome.
+ * \param solved Whether the engine solved the puzzle.
+ * \param solution Solution found by the engine.
+ *
+ * \return true if the outcomes agree.
+ */
+static bool agree (const char* engine, const int index, const Case& reference, const bool solved,
+  const Grid& solution)
+{
+  if (solved != reference.solved)
+  {
+    printf ("MISMATCH! %s %s puzzle %d, the CSP engine %s it.\n", engine, (solved ? "solved" :
+      "did not solve"), index, (reference.solved ? "solved" : "did not solve"));
+    return false;
+  }
+  if (solved && solution != reference.solution)
+  {
+    printf ("MISMATCH! %s found another solution of puzzle %d.\n", engine, index);
+    return false;
+  }
+
+  return true;
+}
+
+/*! \brief Adds a clue that contradicts the solution of a unique puzzle, but none of its clues. The
+ * puzzle then has no solution at all.
+ *
+ * \param puzzle Unique puzzle.
+ * \param solution Its solution.
+ *
+ * \return false if no such clue exists, true otherwise.
+ */
+static bool break_puzzle (Grid& puzzle, const Grid& solution)
+{
+  for (int k = 0; k < 81; ++k)
+  {
+    const int r = k / 9;
+    const int c = k % 9;
+
+    if (puzzle[r][c] != 0)
+    {
+      continue;
+    }
+    for (int v = 1; v <= 9; ++v)
+    {
+      bool free = (v != solution[r][c]);
+
+      for (int i = 0; i < 9 && free; ++i)
+      {
+        free = puzzle[r][i] != v && puzzle[i][c] != v && \
+        puzzle[3 * (r / 3) + i / 3][3 * (c / 3) + i % 3] != v;
+      }
+      if (free)
+      {
+        puzzle[r][c] = v;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+/*! \brief Commits the forced moves of every puzzle of the corpus with the DLX solver. The moves
+ * must leave no column with a single row, nor an empty one, even when a late move shrinks a
+ * column the scan already went by.
+ *
+ * \return Number of puzzles with a missed move.
+ */
+static int check_forced_moves (const std::vector <Case>& corpus)
+{
+  ExactCoverSolver solver;
+  int misses = 0;
+
+  solver.init (3, 3);
+  for (unsigned int p = 0; p < corpus.size (); ++p)
+  {
+    if (!CrossCheck::force_to_fixpoint (solver, corpus[p].input))
+    {
+      printf ("MISMATCH! dlx left a forced move of puzzle %d uncommitted.\n", p + 1);
+      ++misses;
+    }
+  }
+
+  return misses;
+}
+
+/*! \brief Cancels searches through the library interface, with a flag raised before the search
+ * by every technique, and with one raised by another thread while the search runs. Each search
+ * counts the solutions of an empty grid, which would take far longer than the check. The node
+ * limit only keeps a flag that goes unnoticed from hanging the check.
+ *
+ * \return Number of searches that did not end with TIME_LIMIT.
+ */
+static int check_cancellation ()
+{
+  const uint8_t empty[81] = {0};
+  std::atomic <bool> cancel (true);
+  sudoku::Options options;
+  sudoku::Stats stats;
+  int status = sudoku::SOLVED;
+  int failures = 0;
+
+  options.solution_limit = 1000000000;
+  options.node_limit = 1000000;
+  options.cancel = &cancel;
+  for (int technique = 1; technique <= 4; ++technique)
+  {
+    options.technique = technique;
+    status = sudoku::solve (empty, NULL, options, &stats);
+    if (status != sudoku::TIME_LIMIT)
+    {
+      printf ("MISMATCH! A raised cancellation flag left technique %d with %s after %ld nodes.\n",
+        technique, sudoku::status_name (status), stats.nodes);
+      ++failures;
+    }
+  }
+  options.technique = 1;
+  cancel = false;
+  std::thread canceller ([&cancel] ()
+  {
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    cancel = true;
+  });
+  status = sudoku::solve (empty, NULL, options, &stats);
+  canceller.join ();
+  if (status != sudoku::TIME_LIMIT)
+  {
+    printf ("MISMATCH! A search cancelled while running ended with %s after %ld nodes.\n",
+      sudoku::status_name (status), stats.nodes);
+    ++failures;
+  }
+
+  return failures;
+}
+
+/*! \brief Solves the corpus one puzzle at a time with a propagation kernel.
+ *
+ * \return Number of mismatches.
+ */
+static int check_kernel (const char* name, BitboardSolver::Kernel kernel,
+  const std::vector <Case>& corpus)
+{
+  BitboardSolver solver;
+  Grid solution;
+  int mismatches = 0;
+
+  solver.set_quiet (true);
+  CrossCheck::use_kernel (solver, kernel, name);
+  for (unsigned int p = 0; p < corpus.size (); ++p)
+  {
+    solver.solve (corpus[p].input);
+    solution.assign (9, std::vector <int> (9, 0));
+    if (solver.is_solved ())
+    {
+      solver.output (solution);
+    }
+    mismatches += !agree (name, p + 1, corpus[p], solver.is_solved (), solution);
+  }
+
+  return mismatches;
+}
+
+/*! \brief Solves the corpus with a batch kernel, one slice of width puzzles at a time. The last
+ * slice may be partial.
+ *
+ * \return Number of mismatches.
+ */
+static int check_batch_kernel (const char* name, BitboardSolver::BatchKernel kernel,
+  const int width, const std::vector <Case>& corpus)
+{
+  BitboardSolver solver;
+  std::vector <BitboardSolver::State> states (width);
+  std::vector <char> loaded (width);
+  std::unique_ptr <bool[]> valid (new bool[width]);
+  Grid solution;
+  int mismatches = 0;
+
+  solver.set_quiet (true);
+  /// Puzzles left for the search use the same kernel as the command-line tool
+  solver.set_vectorized (true);
+  CrossCheck::use_batch_kernel (solver, kernel, width);
+  for (unsigned int begin = 0; begin < corpus.size (); begin += width)
+  {
+    const int count = std::min ((int) (corpus.size () - begin), width);
+
+    for (int i = 0; i < count; ++i)
+    {
+      loaded[i] = BitboardSolver::load (corpus[begin + i].input, states[i], true);
+      if (!loaded[i])
+      {
+        memset (&states[i], 0, sizeof (BitboardSolver::State));
+      }
+    }
+    solver.propagate_batch (&states[0], count, valid.get ());
+    for (int i = 0; i < count; ++i)
+    {
+      bool solved = false;
+
+      solution.assign (9, std::vector <int> (9, 0));
+      if (loaded[i] && valid[i])
+      {
+        solver.solve (states[i]);
+        solved = solver.is_solved ();
+        if (solved)
+        {
+          solver.output (solution);
+        }
+      }
+      mismatches += !agree (name, begin + i + 1, corpus[begin + i], solved, solution);
+    }
+  }
+
+  return mismatches;
+}
+
+int main (int argc, char** argv)
+{
+  int count = 100;
+  unsigned int seed = 1;
+  SudokuSolver csp;
+  SudokuSolver dlx;
+  PuzzleGenerator generator;
+  std::vector <Case> corpus;
+  Grid solution;
+  int unsolvable = 0;
+  int mismatches = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 < argc && (strcmp (argv[i], "-n") == 0 || strcmp (argv[i], "--count") == 0))
+    {
+      count = std::max (1, atoi (argv[++i]));
+    }
+    else if (i + 1 < argc && (strcmp (argv[i], "-s") == 0 || strcmp (argv[i], "--seed") == 0))
+    {
+      seed = atol (argv[++i]);
+    }
+    else
+    {
+      printf ("Usage: SudokuCheck [-n <count>] [-s <seed>]\n");
+      return 0;
+    }
+  }
+  csp.init ();
+  csp.set_technique (1);
+  csp.toggle_quiet (true);
+  dlx.init ();
+  dlx.set_technique (2);
+  dlx.toggle_quiet (true);
+  generator.init (3, 3);
+  generator.seed (seed);
+  /// Unsolvable puzzles follow their unique ones, so that every slice of the batch kernels mixes
+  /// live and contradictory lanes
+  for (int p = 0; p < CLASSIC_COUNT + count; ++p)
+  {
+    Case unique;
+
+    unique.input.assign (9, std::vector <int> (9, 0));
+    if (p < CLASSIC_COUNT)
+    {
+      for (int k = 0; k < 81; ++k)
+      {
+        const char c = CLASSICS[p][k];
+
+        unique.input[k / 9][k % 9] = (c >= '1' && c <= '9' ? c - '0' : 0);
+      }
+    }
+    else if (generator.generate (CLUES[p % CLUE_TIERS], unique.input) == 0)
+    {
+      printf ("ERROR! Could not generate puzzle %d.\n", p + 1);
+      return 1;
+    }
+    corpus.push_back (unique);
+    if (solve (dlx, unique.input, solution) && break_puzzle (unique.input, solution))
+    {
+      corpus.push_back (unique);
+    }
+  }
+  for (int p = 0; p < REGRESSION_COUNT; ++p)
+  {
+    Case regression;
+
+    regression.input.assign (9, std::vector <int> (9, 0));
+    for (int k = 0; k < 81; ++k)
+    {
+      const char c = REGRESSIONS[p][k];
+
+      regression.input[k / 9][k % 9] = (c >= '1' && c <= '9' ? c - '0' : 0);
+    }
+    corpus.push_back (regression);
+  }
+  /// The CSP engine is the reference, the DLX engine must agree with it
+  for (unsigned int p = 0; p < corpus.size (); ++p)
+  {
+    corpus[p].solved = solve (csp, corpus[p].input, corpus[p].solution);
+    if (!corpus[p].solved)
+    {
+      corpus[p].solution.assign (9, std::vector <int> (9, 0));
+      ++unsolvable;
+    }
+  }
+  for (unsigned int p = 0; p < corpus.size (); ++p)
+  {
+    const bool solved = solve (dlx, corpus[p].input, solution);
+
+    mismatches += !agree ("dlx", p + 1, corpus[p], solved, solution);
+  }
+  printf ("Checking %d puzzles, %d of them unsolvable.\n", (int) corpus.size (), unsolvable);
+  mismatches += check_forced_moves (corpus);
+  mismatches += check_cancellation ();
+  mismatches += check_kernel ("scalar", NULL, corpus);
+  mismatches += check_kernel ("portable", &propagate_portable, corpus);
+  mismatches += check_batch_kernel ("batch portable", &propagate_batch_portable, 4, corpus);
+#if defined(__SSE2__)
+  mismatches += check_kernel ("sse2", &propagate_sse2, corpus);
+  mismatches += check_batch_kernel ("batch sse2", &propagate_batch_sse2, 4, corpus);
+#else
+  printf ("Skipping the SSE2 kernels, they are not built for this target.\n");
+#endif
+#if defined(__x86_64__)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    mismatches += check_kernel ("avx2", &propagate_avx2, corpus);
+    mismatches += check_batch_kernel ("batch avx2", &propagate_batch_avx2, 8, corpus);
+  }
+  else
+  {
+    printf ("Skipping the AVX2 kernels, the host CPU does not support them.\n");
+  }
+#else
+  printf ("Skipping the AVX2 kernels, they are not built for this target.\n");
+#endif
+  if (mismatches > 0)
+  {
+    printf ("FAILED! %d mismatch(es).\n", mismatches);
+    return 1;
+  }
+  printf ("All engines and kernels agree.\n");
+
+  return 0;
+}